@@ -0,0 +1,164 @@
+/**
+* (C) 2020 Geotab Inc
+* (C) 2018 Volvo Cars
+*
+* All files and artifacts in this repository are licensed under the
+* provisions of the license provided by the LICENSE file in this repository.
+*
+*
+* Benchmark of the binary tree writer: per-node createBinaryCnode() versus a writer session and a packed whole tree.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "binarytool.h"
+
+#define BRANCHFANOUT 8
+#define LEAFFANOUT 12
+
+typedef struct benchTree_t {
+    int depth;
+    int totalNodes;
+} benchTree_t;
+
+typedef void (*nodeWriter_t)(void* target, char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, int children);
+
+static void legacyNodeWriter(void* target, char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, int children) {
+    createBinaryCnode((char*)target, name, type, uuid, descr, datatype, min, max, unit, "", "", "", children);
+}
+
+static void sessionNodeWriter(void* target, char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, int children) {
+    appendBinaryCnode((binaryWriter_t*)target, name, type, uuid, descr, datatype, min, max, unit, "", "", "", children);
+}
+
+typedef struct packedBuf_t {
+    char* buf;
+    size_t len;
+    size_t size;
+} packedBuf_t;
+
+static void packBytes(packedBuf_t* packed, const void* data, size_t len) {
+    if (packed->len + len > packed->size) {
+        packed->size = (packed->len + len) * 2;
+        packed->buf = (char*) realloc(packed->buf, packed->size);
+    }
+    memcpy(&(packed->buf[packed->len]), data, len);
+    packed->len += len;
+}
+
+static void packUint32(packedBuf_t* packed, uint32_t value) {
+    uint8_t bytes[4] = {value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF};
+    packBytes(packed, bytes, 4);
+}
+
+static void packedNodeWriter(void* target, char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, int children) {
+    char* fields[NUMOFNODEFIELDS] = {name, type, uuid, descr, datatype, min, max, unit, "", "", ""};
+    for (int i = 0 ; i < NUMOFNODEFIELDS ; i++) {
+        packUint32((packedBuf_t*)target, (uint32_t)strlen(fields[i]));
+        packBytes((packedBuf_t*)target, fields[i], strlen(fields[i]));
+    }
+    packUint32((packedBuf_t*)target, (uint32_t)children);
+}
+
+/**
+* Writes a synthetic VSS-like tree in pre-order: branches with BRANCHFANOUT sub-branches down to the given depth,
+* where the lowest branches carry LEAFFANOUT sensors each.
+**/
+static void writeSyntheticNode(benchTree_t* tree, int level, int index, nodeWriter_t writer, void* target) {
+    char name[32];
+    char uuid[33];
+    snprintf(uuid, sizeof(uuid), "%032x", tree->totalNodes);
+    tree->totalNodes++;
+    if (level == tree->depth) {
+        snprintf(name, sizeof(name), "Signal%d", index);
+        writer(target, name, "sensor", uuid, "Synthetic sensor node used by the binary writer benchmark.", "float", "0", "100", "km/h", 0);
+        return;
+    }
+    int children = level == tree->depth - 1 ? LEAFFANOUT : BRANCHFANOUT;
+    snprintf(name, sizeof(name), level == 0 ? "Vehicle" : "Branch%d", index);
+    writer(target, name, "branch", uuid, "Synthetic branch node used by the binary writer benchmark.", "", "", "", "", children);
+    for (int i = 0 ; i < children ; i++) {
+        writeSyntheticNode(tree, level + 1, i, writer, target);
+    }
+}
+
+static double elapsedMs(struct timespec* start, struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static bool sameFileContent(char* fname1, char* fname2) {
+    FILE* fp1 = fopen(fname1, "r");
+    FILE* fp2 = fopen(fname2, "r");
+    bool same = fp1 != NULL && fp2 != NULL;
+    while (same == true) {
+        int c1 = fgetc(fp1);
+        int c2 = fgetc(fp2);
+        if (c1 != c2) {
+            same = false;
+        }
+        if (c1 == EOF || c2 == EOF) {
+            break;
+        }
+    }
+    if (fp1 != NULL) fclose(fp1);
+    if (fp2 != NULL) fclose(fp2);
+    return same;
+}
+
+int main(int argc, char** argv) {
+    benchTree_t tree;
+    tree.depth = argc > 1 ? atoi(argv[1]) : 4;
+    struct timespec start, end;
+    char* legacyFile = "bench_legacy.binary";
+    char* sessionFile = "bench_session.binary";
+    char* packedFile = "bench_packed.binary";
+
+    remove(legacyFile);
+    tree.totalNodes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    writeSyntheticNode(&tree, 0, 0, legacyNodeWriter, legacyFile);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double legacyMs = elapsedMs(&start, &end);
+
+    tree.totalNodes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    binaryWriter_t* writer = openBinaryCtree(sessionFile, 1);
+    if (writer == NULL) {
+        return 1;
+    }
+    writeSyntheticNode(&tree, 0, 0, sessionNodeWriter, writer);
+    if (closeBinaryCtree(writer) != 0) {
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double sessionMs = elapsedMs(&start, &end);
+
+    packedBuf_t packed = {NULL, 0, 0};
+    tree.totalNodes = 0;
+    writeSyntheticNode(&tree, 0, 0, packedNodeWriter, &packed);  // packing is done by the caller, e.g. in Python
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (createBinaryCtree(packedFile, packed.buf, packed.len, tree.totalNodes, 1) != 0) {
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double packedMs = elapsedMs(&start, &end);
+    free(packed.buf);
+
+    printf("Nodes written = %d\n", tree.totalNodes);
+    printf("createBinaryCnode per node: %.1f ms\n", legacyMs);
+    printf("Writer session:             %.1f ms (speedup %.1fx)\n", sessionMs, legacyMs / sessionMs);
+    printf("Packed whole tree:          %.1f ms (speedup %.1fx)\n", packedMs, legacyMs / packedMs);
+    if (sameFileContent(legacyFile, sessionFile) == false || sameFileContent(legacyFile, packedFile) == false) {
+        printf("Output files differ!\n");
+        return 1;
+    }
+    remove(legacyFile);
+    remove(sessionFile);
+    remove(packedFile);
+    return 0;
+}
@@ -0,0 +1,21 @@
+/**
+* (C) 2020 Geotab Inc
+* (C) 2018 Volvo Cars
+*
+* All files and artifacts in this repository are licensed under the
+* provisions of the license provided by the LICENSE file in this repository.
+*
+*
+* Constants of the binary format of a VSS tree that are shared by the writer in binarytool.c and the parser in c_parser/cparserlib.c.
+**/
+
+#ifndef BINARYFORMAT_H
+#define BINARYFORMAT_H
+
+// format version 2 container, see README.md
+#define V2MAGIC "VSSB"
+#define V2HEADERSIZE 32
+#define V2LITTLEENDIAN 1
+#define V2MAXVARINTLEN 5  // bytes of a uint32 as unsigned LEB128
+
+#endif
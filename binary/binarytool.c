@@ -16,70 +16,576 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <limits.h>
+#include "binarytool.h"
 
-FILE* treeFp;
+static bool initBuffer(outBuf_t* out, size_t size) {
+    out->buf = (char*) malloc(size);
+    out->used = 0;
+    out->size = size;
+    return out->buf != NULL;
+}
+
+static void bufferWrite(binaryWriter_t* writer, outBuf_t* out, const void* data, size_t len) {
+    if (writer->failed == true) {
+        return;
+    }
+    if (out->used + len > out->size) {
+        size_t newSize = out->size * 2;
+        while (out->used + len > newSize) {
+            newSize *= 2;
+        }
+        char* newBuf = (char*) realloc(out->buf, newSize);
+        if (newBuf == NULL) {
+            printf("Could not allocate %zu bytes for the tree output buffer.\n", newSize);
+            writer->failed = true;
+            return;
+        }
+        out->buf = newBuf;
+        out->size = newSize;
+    }
+    memcpy(&(out->buf[out->used]), data, len);
+    out->used += len;
+}
+
+static void putUint32(uint8_t* buf, uint32_t value) {
+    buf[0] = value & 0xFF;
+    buf[1] = (value >> 8) & 0xFF;
+    buf[2] = (value >> 16) & 0xFF;
+    buf[3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t readPackedUint32(const char* buf) {
+    const uint8_t* bytes = (const uint8_t*)buf;
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static void bufferWriteUint32(binaryWriter_t* writer, outBuf_t* out, uint32_t value) {
+    uint8_t bytes[sizeof(uint32_t)];
+    putUint32(bytes, value);
+    bufferWrite(writer, out, bytes, sizeof(uint32_t));
+}
+
+/**
+* Writes value as unsigned LEB128, 7 bits per byte with the least significant first, and the high bit set in all but the last byte.
+**/
+int encodeVarint(uint8_t* buf, uint32_t value) {
+    int len = 0;
+    while (value >= 0x80) {
+        buf[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[len++] = (uint8_t)value;
+    return len;
+}
+
+static void bufferWriteVarint(binaryWriter_t* writer, outBuf_t* out, uint32_t value) {
+    uint8_t bytes[V2MAXVARINTLEN];
+    bufferWrite(writer, out, bytes, encodeVarint(bytes, value));
+}
+
+static const uint8_t fieldLenBytes[NUMOFNODEFIELDS] = {1, 1, 1, 2, 1, 1, 1, 1, 2, 1, 1};  // descr and allowed have uint16 lengths
+
+/**
+* Format version 1 has no room for longer fields or more children, so such a node fails the write instead of being truncated.
+**/
+static bool fitsFormatV1(nodeField_t* fields, int children) {
+    for (int i = 0 ; i < NUMOFNODEFIELDS ; i++) {
+        if (fields[i].len > (fieldLenBytes[i] == 1 ? UINT8_MAX : UINT16_MAX)) {
+            printf("Field %d of node %.*s is longer than format version 1 allows, use format version 2.\n", i, (int)fields[NAMEFIELD].len, fields[NAMEFIELD].str);
+            return false;
+        }
+    }
+    if (children < 0 || children > UINT8_MAX) {
+        printf("Node %.*s has more children than format version 1 allows, use format version 2.\n", (int)fields[NAMEFIELD].len, fields[NAMEFIELD].str);
+        return false;
+    }
+    return true;
+}
+
+static void writeNodeFieldsV1(binaryWriter_t* writer, nodeField_t* fields, int children) {
+    if (fitsFormatV1(fields, children) == false) {
+        writer->failed = true;
+        return;
+    }
+    for (int i = 0 ; i < NUMOFNODEFIELDS ; i++) {
+        if (fieldLenBytes[i] == 1) {
+            uint8_t len = (uint8_t)fields[i].len;
+            bufferWrite(writer, &writer->nodes, &len, sizeof(uint8_t));
+            bufferWrite(writer, &writer->nodes, fields[i].str, sizeof(char)*len);
+        } else {
+            uint16_t len = (uint16_t)fields[i].len;
+            bufferWrite(writer, &writer->nodes, &len, sizeof(uint16_t));
+            bufferWrite(writer, &writer->nodes, fields[i].str, sizeof(char)*len);
+        }
+    }
+    uint8_t numOfChildren = (uint8_t)children;
+    bufferWrite(writer, &writer->nodes, &numOfChildren, sizeof(uint8_t));
+}
+
+#define INTERNTABLEINITSIZE 4096
+
+static bool initInternTable(internTable_t* table) {
+    table->slots = (uint32_t*) calloc(2*INTERNTABLEINITSIZE, sizeof(uint32_t));
+    table->mask = INTERNTABLEINITSIZE - 1;
+    table->used = 0;
+    return table->slots != NULL;
+}
+
+static uint32_t hashString(const char* str, uint32_t len) {  // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0 ; i < len ; i++) {
+        hash = (hash ^ (uint8_t)str[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void insertInternSlot(internTable_t* table, uint32_t hash, uint32_t offset) {
+    uint32_t slot = hash & table->mask;
+    while (table->slots[2*slot+1] != 0) {
+        slot = (slot + 1) & table->mask;
+    }
+    table->slots[2*slot] = hash;
+    table->slots[2*slot+1] = offset + 1;
+    table->used++;
+}
+
+static bool growInternTable(internTable_t* table) {
+    internTable_t grown = {(uint32_t*) calloc(4*(size_t)(table->mask + 1), sizeof(uint32_t)), 2*table->mask + 1, 0};
+    if (grown.slots == NULL) {
+        return false;
+    }
+    for (uint32_t slot = 0 ; slot <= table->mask ; slot++) {
+        if (table->slots[2*slot+1] != 0) {
+            insertInternSlot(&grown, table->slots[2*slot], table->slots[2*slot+1] - 1);
+        }
+    }
+    free(table->slots);
+    *table = grown;
+    return true;
+}
+
+/**
+* Returns the pool offset of the string, which is only added to the pool if it is not there already.
+**/
+static uint32_t internString(binaryWriter_t* writer, outBuf_t* pool, internTable_t* table, const char* str, uint32_t len) {
+    uint32_t hash = hashString(str, len);
+    for (uint32_t slot = hash & table->mask ; table->slots[2*slot+1] != 0 ; slot = (slot + 1) & table->mask) {
+        uint32_t pooledOffset = table->slots[2*slot+1] - 1;
+        const char* pooled = &(pool->buf[pooledOffset]);
+        if (table->slots[2*slot] == hash && pool->used - pooledOffset > len && memcmp(pooled, str, len) == 0 && pooled[len] == '\0') {
+            return pooledOffset;
+        }
+    }
+    uint32_t offset = (uint32_t)pool->used;
+    bufferWrite(writer, pool, str, len);
+    bufferWrite(writer, pool, "", 1);
+    if (2*(table->used + 1) > table->mask + 1 && growInternTable(table) == false) {
+        writer->failed = true;
+        return 0;
+    }
+    insertInternSlot(table, hash, offset);
+    return offset;
+}
+
+/**
+* Adds the string to the pool, unless it is there already, and writes the varint (pool offset, length) reference to it in the node record.
+* Pool offset 0 holds the empty string. Cold strings go to the end of the pool, and their offsets are relative to
+* the start of the cold strings, which also start with the empty string.
+**/
+static void writeStringRef(binaryWriter_t* writer, const char* str, uint32_t len, bool cold) {
+    uint32_t offset = 0;
+    if (len > 0 && writer->failed == false) {
+        if (cold == true) {
+            offset = internString(writer, &writer->coldPool, &writer->coldPoolStrings, str, len);
+        } else {
+            offset = internString(writer, &writer->pool, &writer->poolStrings, str, len);
+        }
+    }
+    bufferWriteVarint(writer, &writer->nodes, offset);
+    bufferWriteVarint(writer, &writer->nodes, len);
+}
+
+static int hexCharToInt(char hexChar) {
+    if (hexChar >= '0' && hexChar <= '9') {
+        return hexChar - '0';
+    }
+    if (hexChar >= 'A' && hexChar <= 'F') {
+        return hexChar - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+* Gets the element of the allowed field at *index, and moves *index past it. Returns false if the field is malformed.
+* The allowed field has the format "XXallowed1XXallowed2...", where XX is the hex length of the following element.
+* A format version 2 tree from createBinaryCtree() instead packs the elements, see binarytool.h, so that they are not limited to 255 bytes.
+**/
+static bool nextAllowedElement(binaryWriter_t* writer, nodeField_t* allowed, uint32_t* index, nodeField_t* element) {
+    uint32_t remaining = allowed->len - *index;
+    if (writer->packedAllowed == true) {
+        if (remaining < sizeof(uint32_t) || remaining - sizeof(uint32_t) < readPackedUint32(&(allowed->str[*index]))) {
+            return false;
+        }
+        element->len = readPackedUint32(&(allowed->str[*index]));
+        element->str = &(allowed->str[*index + sizeof(uint32_t)]);
+        *index += sizeof(uint32_t) + element->len;
+        return true;
+    }
+    int high = remaining >= 2 ? hexCharToInt(allowed->str[*index]) : -1;
+    int low = remaining >= 2 ? hexCharToInt(allowed->str[*index+1]) : -1;
+    if (high < 0 || low < 0 || (uint32_t)(high * 16 + low) > remaining - 2) {
+        return false;
+    }
+    element->len = (uint32_t)(high * 16 + low);
+    element->str = &(allowed->str[*index + 2]);
+    *index += element->len + 2;
+    return true;
+}
+
+/**
+* Format version 2 stores the allowed field as the number of elements followed by one string reference per element.
+**/
+static void writeAllowedV2(binaryWriter_t* writer, nodeField_t* allowed) {
+    uint32_t first = 0;
+    bool wellFormed = true;
+    if (writer->packedAllowed == true && allowed->len > 0) {
+        wellFormed = allowed->len >= sizeof(uint32_t);
+        first = sizeof(uint32_t);  // after the number of elements
+    }
+    uint32_t count = 0;
+    nodeField_t element;
+    for (uint32_t index = first ; wellFormed == true && index < allowed->len ; count++) {
+        wellFormed = nextAllowedElement(writer, allowed, &index, &element);
+    }
+    if (wellFormed == true && writer->packedAllowed == true && allowed->len > 0) {
+        wellFormed = readPackedUint32(allowed->str) == count;
+    }
+    if (wellFormed == false) {
+        printf("Malformed allowed string, the tree is not written.\n");
+        writer->failed = true;
+        return;
+    }
+    bufferWriteVarint(writer, &writer->nodes, count);
+    for (uint32_t index = first ; index < allowed->len ; ) {
+        nextAllowedElement(writer, allowed, &index, &element);
+        writeStringRef(writer, element.str, element.len, false);
+    }
+}
+
+static bool fieldEquals(nodeField_t* field, const char* str, uint32_t len) {
+    return field->len == len && memcmp(field->str, str, len) == 0;
+}
+
+static bool fieldContains(nodeField_t* field, const char* str) {
+    uint32_t len = (uint32_t)strlen(str);
+    for (uint32_t i = 0 ; i + len <= field->len ; i++) {
+        if (memcmp(&(field->str[i]), str, len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* The node type, datatype and validate fields are one byte codes in format version 2, see README.md.
+* Node type codes are 1 to 6 in nodeTypeNames order, 0 is an unknown type.
+**/
+static const char* nodeTypeNames[] = {"sensor", "actuator", "attribute", "branch", "struct", "property"};
+
+/**
+* Datatype codes are 1 to 12 in datatypeNames order, 0 is no datatype and 13 is any other datatype, e.g. a struct.
+* DATATYPEARRAY is added to the code of the base datatype of an array, which is the datatype with the "[]" suffix removed.
+**/
+static const char* datatypeNames[] = {"int8", "uint8", "int16", "uint16", "int32", "uint32", "int64", "uint64", "boolean", "float", "double", "string"};
+#define DATATYPEOTHER 13
+#define DATATYPEARRAY 0x80
+
+static uint8_t nodeTypeCode(nodeField_t* type) {
+    for (uint8_t i = 0 ; i < sizeof(nodeTypeNames)/sizeof(nodeTypeNames[0]) ; i++) {
+        if (fieldEquals(type, nodeTypeNames[i], (uint32_t)strlen(nodeTypeNames[i]))) {
+            return i + 1;
+        }
+    }
+    printf("Unknown node type=%.*s, it is written as code 0.\n", (int)type->len, type->str);
+    return 0;
+}
+
+static uint8_t datatypeCode(nodeField_t* datatype) {
+    if (datatype->len == 0) {
+        return 0;
+    }
+    nodeField_t base = *datatype;
+    uint8_t arrayFlag = 0;
+    if (base.len > 2 && base.str[base.len-2] == '[' && base.str[base.len-1] == ']') {
+        arrayFlag = DATATYPEARRAY;
+        base.len -= 2;
+    }
+    for (uint8_t i = 0 ; i < sizeof(datatypeNames)/sizeof(datatypeNames[0]) ; i++) {
+        if (fieldEquals(&base, datatypeNames[i], (uint32_t)strlen(datatypeNames[i]))) {
+            return (i + 1) | arrayFlag;
+        }
+    }
+    return DATATYPEOTHER | arrayFlag;
+}
+
+/**
+* Same mapping as in the parsers: 1 for write-only, 2 for read-write, plus 10 if consent is required.
+**/
+static uint8_t validateCode(nodeField_t* validate) {
+    uint8_t code = 0;
+    if (fieldContains(validate, "write-only")) {
+        code = 1;
+    } else if (fieldContains(validate, "read-write")) {
+        code = 2;
+    }
+    if (fieldContains(validate, "consent")) {
+        code += 10;
+    }
+    return code;
+}
+
+static void writeCode(binaryWriter_t* writer, uint8_t code) {
+    bufferWrite(writer, &writer->nodes, &code, 1);
+}
+
+/**
+* The fields needed for the tree structure and searches come first in the record, so that a reader can defer the decoding of the attributes after them.
+**/
+static void writeNodeFieldsV2(binaryWriter_t* writer, nodeField_t* fields, int children) {
+    bufferWriteUint32(writer, &writer->offsets, (uint32_t)writer->nodes.used);
+    writeStringRef(writer, fields[NAMEFIELD].str, fields[NAMEFIELD].len, false);
+    writeCode(writer, nodeTypeCode(&fields[TYPEFIELD]));
+    writeCode(writer, datatypeCode(&fields[DATATYPEFIELD]));  // followed by the datatype string, which names the struct of an other datatype
+    writeStringRef(writer, fields[DATATYPEFIELD].str, fields[DATATYPEFIELD].len, false);
+    writeCode(writer, validateCode(&fields[VALIDATEFIELD]));
+    bufferWriteVarint(writer, &writer->nodes, (uint32_t)children);
+    writeStringRef(writer, fields[UUIDFIELD].str, fields[UUIDFIELD].len, false);
+    writeStringRef(writer, fields[DESCRFIELD].str, fields[DESCRFIELD].len, true);
+    writeStringRef(writer, fields[MINFIELD].str, fields[MINFIELD].len, false);
+    writeStringRef(writer, fields[MAXFIELD].str, fields[MAXFIELD].len, false);
+    writeStringRef(writer, fields[UNITFIELD].str, fields[UNITFIELD].len, false);
+    writeAllowedV2(writer, &fields[ALLOWEDFIELD]);
+    writeStringRef(writer, fields[DEFAULTFIELD].str, fields[DEFAULTFIELD].len, false);
+}
+
+/**
+* Keeps track of the tree depth from the children count of the nodes, which arrive in pre-order.
+**/
+static void updateDepth(binaryWriter_t* writer, int children) {
+    if (writer->depthStackLen + 1 > writer->maxDepth) {
+        writer->maxDepth = writer->depthStackLen + 1;
+    }
+    if (writer->depthStackLen > 0) {
+        writer->depthStack[writer->depthStackLen-1]--;
+    }
+    if (children > 0) {
+        if (writer->depthStackLen == writer->depthStackSize) {
+            uint32_t* newStack = (uint32_t*) realloc(writer->depthStack, sizeof(uint32_t)*writer->depthStackSize*2);
+            if (newStack == NULL) {
+                writer->failed = true;
+                return;
+            }
+            writer->depthStack = newStack;
+            writer->depthStackSize *= 2;
+        }
+        writer->depthStack[writer->depthStackLen++] = (uint32_t)children;
+    } else {
+        while (writer->depthStackLen > 0 && writer->depthStack[writer->depthStackLen-1] == 0) {
+            writer->depthStackLen--;
+        }
+    }
+}
+
+static void writeNodeFields(binaryWriter_t* writer, nodeField_t* fields, int children) {
+    if (writer->formatVersion == 2) {
+        writeNodeFieldsV2(writer, fields, children);
+    } else {
+        writeNodeFieldsV1(writer, fields, children);
+    }
+    updateDepth(writer, children);
+    writer->nodeCount++;
+}
 
-void writeNodeData(char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, char* allowed, char* defaultAllowed, char* validate, int children) {
+static void setField(nodeField_t* field, char* str) {
+    field->str = str;
+    field->len = (uint32_t)strlen(str);
+}
+
+static void writeNodeData(binaryWriter_t* writer, char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, char* allowed, char* defaultAllowed, char* validate, int children) {
 //printf("Name=%s, Type=%s, uuid=%s, validate=%s, children=%d, Descr=%s, datatype=%s, min=%s, max=%s Unit=%s, Allowed=%s\n", name, type, uuid, validate, children, descr, datatype, min, max, unit, allowed);
-    uint8_t nameLen  = (uint8_t)strlen(name);
-    uint8_t typeLen = (uint8_t)strlen(type);
-    uint8_t uuidLen  = (uint8_t)strlen(uuid);
-    uint16_t descrLen = (uint16_t)strlen(descr);
-    uint8_t datatypeLen = (uint8_t)strlen(datatype);
-    uint8_t minLen = (uint8_t)strlen(min);
-    uint8_t maxLen = (uint8_t)strlen(max);
-    uint8_t unitLen = (uint8_t)strlen(unit);
-    uint16_t allowedLen = (uint16_t)strlen(allowed);
-    uint8_t defaultAllowedLen = (uint8_t)strlen(defaultAllowed);
-    uint8_t validateLen = (uint8_t)strlen(validate);
-    
-    fwrite(&nameLen, sizeof(uint8_t), 1, treeFp);
-    fwrite(name, sizeof(char)*nameLen, 1, treeFp);
-    fwrite(&typeLen, sizeof(uint8_t), 1, treeFp);
-    fwrite(type, sizeof(char)*typeLen, 1, treeFp);
-    fwrite(&uuidLen, sizeof(uint8_t), 1, treeFp);
-    fwrite(uuid, sizeof(char)*uuidLen, 1, treeFp);
-    fwrite(&descrLen, sizeof(uint16_t), 1, treeFp);
-    fwrite(descr, sizeof(char)*descrLen, 1, treeFp);
-    fwrite(&datatypeLen, sizeof(uint8_t), 1, treeFp);
-    if (datatypeLen > 0) {
-        fwrite(datatype, sizeof(char)*datatypeLen, 1, treeFp);
-    }
-    fwrite(&minLen, sizeof(uint8_t), 1, treeFp);
-    if (minLen > 0) {
-        fwrite(min, sizeof(char)*minLen, 1, treeFp);
-    }
-    fwrite(&maxLen, sizeof(uint8_t), 1, treeFp);
-    if (maxLen > 0) {
-        fwrite(max, sizeof(char)*maxLen, 1, treeFp);
-    }
-    fwrite(&unitLen, sizeof(uint8_t), 1, treeFp);
-    if (unitLen > 0) {
-        fwrite(unit, sizeof(char)*unitLen, 1, treeFp);
-    }
-    fwrite(&allowedLen, sizeof(uint16_t), 1, treeFp);
-    if (allowedLen > 0) {
-        fwrite(allowed, sizeof(char)*allowedLen, 1, treeFp);
-    }
-    fwrite(&defaultAllowedLen, sizeof(uint8_t), 1, treeFp);
-    if (defaultAllowedLen > 0) {
-        fwrite(defaultAllowed, sizeof(char)*defaultAllowedLen, 1, treeFp);
-    }
-    fwrite(&validateLen, sizeof(uint8_t), 1, treeFp);
-    if (validateLen > 0) {
-        fwrite(validate, sizeof(char)*validateLen, 1, treeFp);
-    }
-    fwrite(&children, sizeof(uint8_t), 1, treeFp);
+    nodeField_t fields[NUMOFNODEFIELDS];
+    setField(&fields[NAMEFIELD], name);
+    setField(&fields[TYPEFIELD], type);
+    setField(&fields[UUIDFIELD], uuid);
+    setField(&fields[DESCRFIELD], descr);
+    setField(&fields[DATATYPEFIELD], datatype);
+    setField(&fields[MINFIELD], min);
+    setField(&fields[MAXFIELD], max);
+    setField(&fields[UNITFIELD], unit);
+    setField(&fields[ALLOWEDFIELD], allowed);
+    setField(&fields[DEFAULTFIELD], defaultAllowed);
+    setField(&fields[VALIDATEFIELD], validate);
+    writeNodeFields(writer, fields, children);
 }
 
-void createBinaryCnode(char*fname, char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, char* allowed, char* defaultAllowed, char* validate, int children) {
-    treeFp = fopen(fname, "a");
-    if (treeFp == NULL) {
+static int writePackedNodes(binaryWriter_t* writer, char* packedNodes, size_t packedLen, int nodeCount) {
+    nodeField_t fields[NUMOFNODEFIELDS];
+    size_t index = 0;
+    for (int node = 0 ; node < nodeCount ; node++) {
+        for (int i = 0 ; i < NUMOFNODEFIELDS ; i++) {
+            if (packedLen - index < sizeof(uint32_t)) {
+                return -1;
+            }
+            fields[i].len = readPackedUint32(&packedNodes[index]);
+            index += sizeof(uint32_t);
+            if (packedLen - index < fields[i].len) {
+                return -1;
+            }
+            fields[i].str = &packedNodes[index];
+            index += fields[i].len;
+        }
+        if (packedLen - index < sizeof(uint32_t)) {
+            return -1;
+        }
+        uint32_t children = readPackedUint32(&packedNodes[index]);
+        index += sizeof(uint32_t);
+        writeNodeFields(writer, fields, (int)children);
+    }
+    return index == packedLen ? 0 : -1;
+}
+
+static void freeWriter(binaryWriter_t* writer) {
+    free(writer->nodes.buf);
+    free(writer->offsets.buf);
+    free(writer->pool.buf);
+    free(writer->coldPool.buf);
+    free(writer->poolStrings.slots);
+    free(writer->coldPoolStrings.slots);
+    free(writer->depthStack);
+    free(writer->fname);
+    free(writer->tmpFname);
+    free(writer);
+}
+
+static binaryWriter_t* openWriter(char* fname, char* mode, size_t bufSize, int formatVersion) {
+    if (formatVersion != 1 && formatVersion != 2) {
+        printf("Unsupported binary format version=%d.\n", formatVersion);
+        return NULL;
+    }
+    binaryWriter_t* writer = (binaryWriter_t*) calloc(1, sizeof(binaryWriter_t));
+    if (writer == NULL) {
+        return NULL;
+    }
+    writer->depthStackSize = 16;
+    writer->depthStack = (uint32_t*) malloc(sizeof(uint32_t)*writer->depthStackSize);
+    bool allocated = initBuffer(&writer->nodes, bufSize) && writer->depthStack != NULL;
+    if (formatVersion == 2) {
+        allocated = allocated && initBuffer(&writer->offsets, bufSize/16) && initBuffer(&writer->pool, bufSize) &&
+                    initBuffer(&writer->coldPool, bufSize) && initInternTable(&writer->poolStrings) && initInternTable(&writer->coldPoolStrings);
+    }
+    if (allocated == false) {
+        freeWriter(writer);
+        return NULL;
+    }
+    if (strcmp(mode, "w") == 0) {  // written to a temporary file that replaces the file when the whole tree is written
+        size_t fnameLen = strlen(fname);
+        writer->fname = (char*) malloc(fnameLen + 1);
+        writer->tmpFname = (char*) malloc(fnameLen + sizeof(TMPFNAMESUFFIX));
+        if (writer->fname == NULL || writer->tmpFname == NULL) {
+            freeWriter(writer);
+            return NULL;
+        }
+        memcpy(writer->fname, fname, fnameLen + 1);
+        memcpy(writer->tmpFname, fname, fnameLen);
+        memcpy(&writer->tmpFname[fnameLen], TMPFNAMESUFFIX, sizeof(TMPFNAMESUFFIX));
+    }
+    writer->fp = fopen(writer->tmpFname != NULL ? writer->tmpFname : fname, mode);
+    if (writer->fp == NULL) {
         printf("Could not open file=%s for writing of tree.\n", fname);
-        return;
+        freeWriter(writer);
+        return NULL;
+    }
+    writer->formatVersion = formatVersion;
+    if (formatVersion == 2) {
+        bufferWrite(writer, &writer->pool, "", 1);  // the empty string at pool offset 0
+        bufferWrite(writer, &writer->coldPool, "", 1);
+    }
+    return writer;
+}
+
+binaryWriter_t* openBinaryCtree(char* fname, int formatVersion) {
+    return openWriter(fname, "w", WRITEBUFINITSIZE, formatVersion);
+}
+
+int appendBinaryCnode(binaryWriter_t* writer, char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, char* allowed, char* defaultAllowed, char* validate, int children) {
+    writeNodeData(writer, name, type, uuid, descr, datatype, min, max, unit, allowed, defaultAllowed, validate, children);
+    return writer->failed == true ? -1 : 0;
+}
+
+static bool writeToFile(binaryWriter_t* writer) {
+    if (writer->formatVersion == 1) {
+        return fwrite(writer->nodes.buf, 1, writer->nodes.used, writer->fp) == writer->nodes.used;
     }
-    writeNodeData(name, type, uuid, descr, datatype, min, max, unit, allowed, defaultAllowed, validate, children);
-    fclose(treeFp);
+    if (writer->depthStackLen != 0) {
+        printf("The tree is incomplete, %u more subtree(s) expected.\n", writer->depthStackLen);
+        return false;
+    }
+    uint8_t header[V2HEADERSIZE];
+    memset(header, 0, V2HEADERSIZE);
+    memcpy(header, V2MAGIC, 4);
+    header[4] = 2;  // format version
+    header[5] = V2LITTLEENDIAN;
+    header[6] = V2HEADERSIZE;  // uint16 header size
+    putUint32(&header[8], writer->nodeCount);
+    putUint32(&header[12], writer->maxDepth);
+    putUint32(&header[16], (uint32_t)(writer->pool.used + writer->coldPool.used));
+    putUint32(&header[20], (uint32_t)writer->nodes.used);
+    putUint32(&header[24], (uint32_t)writer->pool.used);  // start of the cold strings
+    return fwrite(header, 1, V2HEADERSIZE, writer->fp) == V2HEADERSIZE &&
+           fwrite(writer->offsets.buf, 1, writer->offsets.used, writer->fp) == writer->offsets.used &&
+           fwrite(writer->nodes.buf, 1, writer->nodes.used, writer->fp) == writer->nodes.used &&
+           fwrite(writer->pool.buf, 1, writer->pool.used, writer->fp) == writer->pool.used &&
+           fwrite(writer->coldPool.buf, 1, writer->coldPool.used, writer->fp) == writer->coldPool.used;
 }
 
+int closeBinaryCtree(binaryWriter_t* writer) {
+    int status = 0;
+    if (writer->failed == true || writeToFile(writer) == false) {
+        printf("Could not write the tree to file.\n");
+        status = -1;
+    }
+    if (fclose(writer->fp) != 0) {
+        status = -1;
+    }
+    if (writer->tmpFname != NULL && status == 0 && rename(writer->tmpFname, writer->fname) != 0) {
+        printf("Could not rename file=%s to %s.\n", writer->tmpFname, writer->fname);
+        status = -1;
+    }
+    if (writer->tmpFname != NULL && status != 0) {
+        remove(writer->tmpFname);  // an existing file is left unchanged
+    }
+    freeWriter(writer);
+    return status;
+}
+
+int createBinaryCtree(char* fname, char* packedNodes, size_t packedLen, int nodeCount, int formatVersion) {
+    binaryWriter_t* writer = openBinaryCtree(fname, formatVersion);
+    if (writer == NULL) {
+        return -1;
+    }
+    writer->packedAllowed = formatVersion == 2;
+    if (writePackedNodes(writer, packedNodes, packedLen, nodeCount) != 0) {
+        printf("Malformed packed node buffer, the tree is not written.\n");
+        writer->failed = true;
+    }
+    return closeBinaryCtree(writer);
+}
 
+void createBinaryCnode(char*fname, char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, char* allowed, char* defaultAllowed, char* validate, int children) {
+    binaryWriter_t* writer = openWriter(fname, "a", 512, 1);
+    if (writer == NULL) {
+        return;
+    }
+    writeNodeData(writer, name, type, uuid, descr, datatype, min, max, unit, allowed, defaultAllowed, validate, children);
+    closeBinaryCtree(writer);
+}
@@ -0,0 +1,97 @@
+/**
+* (C) 2020 Geotab Inc
+* (C) 2018 Volvo Cars
+*
+* All files and artifacts in this repository are licensed under the
+* provisions of the license provided by the LICENSE file in this repository.
+*
+*
+* API of the library that writes a VSS tree in binary format to file.
+**/
+
+#ifndef BINARYTOOL_H
+#define BINARYTOOL_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "binaryformat.h"
+
+#define WRITEBUFINITSIZE (1024*1024)  // initial size of the session output buffer, it grows on demand
+#define TMPFNAMESUFFIX ".tmp"  // appended to the file name of the temporary file of a writer session
+
+// node fields in the order they are written to a format version 1 file, and packed for createBinaryCtree(), see README.md
+typedef enum {NAMEFIELD, TYPEFIELD, UUIDFIELD, DESCRFIELD, DATATYPEFIELD, MINFIELD, MAXFIELD, UNITFIELD, ALLOWEDFIELD, DEFAULTFIELD, VALIDATEFIELD, NUMOFNODEFIELDS} nodeFields_t;
+
+typedef struct nodeField_t {
+    const char* str;  // not necessarily null terminated
+    uint32_t len;
+} nodeField_t;
+
+typedef struct outBuf_t {
+    char* buf;
+    size_t used;
+    size_t size;
+} outBuf_t;
+
+/**
+* Open addressing hash table of the strings in a pool, so that a string that is written again refers to the first copy.
+**/
+typedef struct internTable_t {
+    uint32_t* slots;  // pairs of the hash and the pool offset + 1 of a string, an offset of 0 marks a free slot
+    uint32_t mask;    // number of slots - 1, the number of slots is a power of two
+    uint32_t used;
+} internTable_t;
+
+typedef struct binaryWriter_t {
+    FILE* fp;
+    char* fname;
+    char* tmpFname;  // the file that is written, and renamed to fname when the whole tree is written, NULL if fp is fname
+    int formatVersion;
+    outBuf_t nodes;    // node records, which is the whole file for format version 1
+    outBuf_t offsets;  // format version 2 node offset table
+    outBuf_t pool;     // format version 2 string pool
+    outBuf_t coldPool; // format version 2 descriptions, written after the pool so that they stay out of the pages used for search
+    internTable_t poolStrings;
+    internTable_t coldPoolStrings;
+    uint32_t nodeCount;
+    uint32_t maxDepth;
+    uint32_t* depthStack;  // remaining children of the ancestors of the next node
+    uint32_t depthStackLen;
+    uint32_t depthStackSize;
+    bool packedAllowed;  // the allowed field is packed as for a format version 2 createBinaryCtree(), instead of the "XXallowed1XXallowed2..." string
+    bool failed;
+} binaryWriter_t;
+
+/**
+* Writer session: openBinaryCtree() creates a temporary file next to the file, appendBinaryCnode() is called once per node in the
+* pre-order described in README.md, and closeBinaryCtree() writes the buffered nodes to the temporary file, renames it to the file and releases the session.
+* A write that fails removes the temporary file, and leaves an existing file unchanged.
+* formatVersion is 1 for the original format, or 2 for the format with header, node offset table and string pool.
+**/
+binaryWriter_t* openBinaryCtree(char* fname, int formatVersion);
+int appendBinaryCnode(binaryWriter_t* writer, char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, char* allowed, char* defaultAllowed, char* validate, int children);
+int closeBinaryCtree(binaryWriter_t* writer);
+
+/**
+* Whole tree in one call. packedNodes holds nodeCount node records in pre-order, where each record is the
+* NUMOFNODEFIELDS fields in nodeFields_t order, each encoded as a uint32 little endian byte length followed by
+* the bytes of the string, and finally the number of children as a uint32 little endian.
+* The allowed field is the "XXallowed1XXallowed2..." string of format version 1, where XX is the hex length of the following element.
+* For format version 2 it is instead a uint32 little endian count followed by a uint32 little endian length and the bytes of each element,
+* so that an element can be longer than 255 bytes.
+* Returns 0 on success, and -1 if the file could not be written or the packed buffer is malformed.
+**/
+int createBinaryCtree(char* fname, char* packedNodes, size_t packedLen, int nodeCount, int formatVersion);
+
+/**
+* Writes value to buf as the unsigned LEB128 varint of the format version 2 lengths, counts and offsets, and returns the number of bytes,
+* which is at most V2MAXVARINTLEN.
+**/
+int encodeVarint(uint8_t* buf, uint32_t value);
+
+// Legacy per-node API, opens the file in append mode, writes one node and closes the file again.
+void createBinaryCnode(char*fname, char* name, char* type, char* uuid, char* descr, char* datatype, char* min, char* max, char* unit, char* allowed, char* defaultAllowed, char* validate, int children);
+
+#endif
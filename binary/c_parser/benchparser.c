@@ -0,0 +1,633 @@
+/**
+* (C) 2020 Geotab Inc
+* (C) 2018 Volvo Cars
+*
+* All files and artifacts in this repository are licensed under the
+* provisions of the license provided by the LICENSE file in this repository.
+*
+*
+* Benchmark of the tree loading of the C parser: format version 1 read, format version 2 read and mapped, with and without lazy attributes,
+* with only the unit and range attributes, the bytes of each attribute class, the load statistics, and the load and stream parse of trees of 10k, 100k and 1M nodes,
+* of searches with VSSSearchNodes(), with a precompiled pattern, streamed to a callback, and on the compact tree, of exact path lookups,
+* of a batch search of many paths versus one search per path, and of the load and search of a very deep tree.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include "cparserlib.h"
+#include "../binarytool.h"
+
+#define BRANCHFANOUT 8
+#define LEAFFANOUT 12
+#define WIDEFANOUT 300  // children of every branch of the wide tree, which has two levels below the root, more than format version 1 allows
+#define RELOADS 10
+#define BATCHPATHS 500
+#define NUMOFSIZES 3
+#define DEEPLEVELS 100000  // levels of the deep tree, where a recursive load or search would overflow the stack
+
+typedef struct benchTree_t {
+    int depth;
+    int branchFanout;
+    int leafFanout;
+    int totalNodes;
+} benchTree_t;
+
+/**
+* Writes a synthetic VSS-like tree in pre-order: branches with branchFanout sub-branches down to the given depth,
+* where the lowest branches carry leafFanout sensors each.
+**/
+static void writeSyntheticNode(benchTree_t* tree, int level, int index, binaryWriter_t* writer) {
+    char name[32];
+    char uuid[33];
+    snprintf(uuid, sizeof(uuid), "%032x", tree->totalNodes);
+    tree->totalNodes++;
+    if (level == tree->depth) {
+        snprintf(name, sizeof(name), "Signal%d", index);
+        appendBinaryCnode(writer, name, "sensor", uuid, "Synthetic sensor node used by the parser benchmark. The description is typically the longest field of a node, and it is rarely needed by a server.",
+                          "float", "0", "100", "km/h", "", "", "", 0);
+        return;
+    }
+    int children = level == tree->depth - 1 ? tree->leafFanout : tree->branchFanout;
+    snprintf(name, sizeof(name), level == 0 ? "Vehicle" : "Branch%d", index);
+    appendBinaryCnode(writer, name, "branch", uuid, "Synthetic branch node used by the parser benchmark.", "", "", "", "", "", "", "", children);
+    for (int i = 0 ; i < children ; i++) {
+        writeSyntheticNode(tree, level + 1, i, writer);
+    }
+}
+
+static int writeSyntheticTree(char* fname, int depth, int formatVersion, int branchFanout, int leafFanout) {
+    benchTree_t tree = {depth, branchFanout, leafFanout, 0};
+    binaryWriter_t* writer = openBinaryCtree(fname, formatVersion);
+    if (writer == NULL) {
+        return -1;
+    }
+    writeSyntheticNode(&tree, 0, 0, writer);
+    if (closeBinaryCtree(writer) != 0) {
+        return -1;
+    }
+    return tree.totalNodes;
+}
+
+/**
+* Writes a tree that is a chain of depthLevels branches, each with one leaf beside the next branch, and a leaf at the end.
+**/
+static int writeDeepTree(char* fname, int depthLevels) {
+    binaryWriter_t* writer = openBinaryCtree(fname, 2);
+    if (writer == NULL) {
+        return -1;
+    }
+    for (int level = 0 ; level < depthLevels ; level++) {
+        appendBinaryCnode(writer, level == 0 ? "Vehicle" : "Level", "branch", "", "", "", "", "", "", "", "", "", 2);
+        appendBinaryCnode(writer, "Signal", "sensor", "", "", "uint8", "", "", "", "", "", "", 0);
+    }
+    appendBinaryCnode(writer, "Signal", "sensor", "", "", "uint8", "", "", "", "", "", "", 0);
+    return closeBinaryCtree(writer) == 0 ? 2*depthLevels + 1 : -1;
+}
+
+static long fileSizeKb(char* fname) {
+    struct stat fileStat;
+    if (stat(fname, &fileStat) != 0) {
+        return -1;
+    }
+    return (long)(fileStat.st_size / 1024);
+}
+
+static double elapsedMs(struct timespec* start, struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static long residentKb() {
+    long pages = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp != NULL) {
+        if (fscanf(fp, "%*s %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(fp);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+* Loads the tree and reports the load time and the memory that became resident by the load,
+* and the resident memory after the tree has been freed and loaded again RELOADS times.
+**/
+static int loadTree(char* label, char* fname, int loadFlags, int attributes) {
+    struct timespec start, end;
+    long rssBefore = residentKb();
+    loadFlags |= VSS_LOAD_QUIET;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long root = VSSLoadTreeAttributes(fname, loadFlags, attributes, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long rssAfter = residentKb();
+    for (int i = 0 ; i < RELOADS && root != 0 ; i++) {
+        VSSFreeTree(root);
+        root = VSSLoadTreeAttributes(fname, loadFlags, attributes, NULL);
+    }
+    long rssReloaded = residentKb();
+    VSSFreeTree(root);
+    if (root == 0) {
+        printf("%s: loading failed\n", label);
+        return 1;
+    }
+    printf("%-20s %8.1f ms %8ld kB resident, %8ld kB after %d reloads\n", label, elapsedMs(&start, &end), rssAfter - rssBefore, rssReloaded - rssBefore, RELOADS);
+    return 0;
+}
+
+typedef struct streamCount_t {
+    int leaves;
+    long peakKb;
+} streamCount_t;
+
+static int countLeafView(const vssNodeView_t* node, void* userData) {
+    streamCount_t* count = (streamCount_t*)userData;
+    if (node->children == 0) {
+        count->leaves++;
+    }
+    if (node->index % 4096 == 0) {  // the resident memory is sampled, as reading it per node would dominate the parse
+        long rss = residentKb();
+        count->peakKb = rss > count->peakKb ? rss : count->peakKb;
+    }
+    return 0;
+}
+
+/**
+* Parses the file with VSSParseStream(), and reports the parse time and the peak resident memory that the parse added,
+* which includes the mapped pages of a format version 2 file.
+**/
+static int streamTree(char* label, char* fname) {
+    struct timespec start, end;
+    long rssBefore = residentKb();
+    streamCount_t count = {0, rssBefore};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = VSSParseStream(fname, countLeafView, NULL, &count);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (status != VSS_OK) {
+        printf("%s: parsing failed, %s\n", label, VSSGetStatusText(status));
+        return 1;
+    }
+    printf("%-20s %8.1f ms %8ld kB peak resident, %d leaves\n", label, elapsedMs(&start, &end), count.peakKb - rssBefore, count.leaves);
+    return 0;
+}
+
+/**
+* Runs the benchmark mode in a new process, with the arguments up to the first NULL.
+**/
+static int runChild(char* self, char* mode, char* label, char* fname, char* flags, char* attributeMask) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl(self, self, mode, label, fname, flags, attributeMask, (char*)NULL);
+        exit(1);
+    }
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || WIFEXITED(status) == false || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+* Runs each load in a new process, so that every load mode starts from the same resident memory.
+**/
+static int benchLoad(char* self, char* label, char* fname, int loadFlags, int attributes) {
+    char flags[16];
+    char attributeMask[16];
+    snprintf(flags, sizeof(flags), "%d", loadFlags);
+    snprintf(attributeMask, sizeof(attributeMask), "%d", attributes);
+    return runChild(self, "load", label, fname, flags, attributeMask);
+}
+
+static int benchStream(char* self, char* label, char* fname) {
+    return runChild(self, "stream", label, fname, NULL, NULL);
+}
+
+static long loadQuiet(char* fname, int loadFlags) {
+    return VSSLoadTree(fname, loadFlags | VSS_LOAD_QUIET, NULL);
+}
+
+typedef struct streamResult_t {
+    long* handles;
+    int numOfMatches;
+} streamResult_t;
+
+static int saveHandle(long nodeHandle, void* userData) {
+    streamResult_t* result = (streamResult_t*)userData;
+    result->handles[result->numOfMatches++] = nodeHandle;
+    return 0;
+}
+
+/**
+* Times the leaf node search of searchPath with VSSSearchNodes(), VSSSearchPattern(), VSSSearchStream() and VSSCompactSearchPattern(),
+* and checks that they find the same nodes.
+**/
+static int benchSearch(char* fname, char* searchPath, bool anyDepth, int iterations) {
+    struct timespec start, end;
+    long root = loadQuiet(fname, VSS_LOAD_COMPACT);
+    if (root == 0) {
+        return 1;
+    }
+    vssCompactTree_t* compact = VSSGetCompactTree(root);
+    searchData_t* searchData = (searchData_t*) malloc(sizeof(searchData_t)*compact->nodeCount);
+    uint32_t* found = (uint32_t*) malloc(sizeof(uint32_t)*compact->nodeCount);
+    vssPattern_t* pattern = VSSCompilePattern(searchPath);
+    streamResult_t streamed = {(long*) malloc(sizeof(long)*compact->nodeCount), 0};
+    if (searchData == NULL || found == NULL || pattern == NULL || streamed.handles == NULL) {
+        return 1;
+    }
+    int matches = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0 ; i < iterations ; i++) {
+        matches = VSSSearchNodes(searchPath, root, compact->nodeCount, searchData, anyDepth, true, 0, NULL, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double searchMs = elapsedMs(&start, &end) / iterations;
+    int patternMatches = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0 ; i < iterations ; i++) {
+        patternMatches = VSSSearchPattern(pattern, root, compact->nodeCount, searchData, anyDepth, true, 0, NULL, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double patternMs = elapsedMs(&start, &end) / iterations;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0 ; i < iterations ; i++) {
+        streamed.numOfMatches = 0;
+        VSSSearchStream(pattern, root, anyDepth, true, 0, NULL, saveHandle, &streamed, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double streamMs = elapsedMs(&start, &end) / iterations;
+    int compactMatches = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0 ; i < iterations ; i++) {
+        compactMatches = VSSCompactSearchPattern(compact, pattern, anyDepth, true, found, compact->nodeCount);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double compactMs = elapsedMs(&start, &end) / iterations;
+    int failed = matches != patternMatches || matches != streamed.numOfMatches || matches != compactMatches;
+    for (int i = 0 ; i < matches && failed == 0 ; i++) {
+        failed = searchData[i].foundNodeHandles != compact->handles[found[i]] || searchData[i].foundNodeHandles != streamed.handles[i];
+    }
+    printf("Search %s: %d matches, VSSSearchNodes %.3f ms, precompiled %.3f ms, streamed %.3f ms, compact %.3f ms (speedup %.1fx)%s\n",
+           searchPath, matches, searchMs, patternMs, streamMs, compactMs, searchMs / compactMs, failed ? ", RESULTS DIFFER" : "");
+    VSSFreePattern(pattern);
+    free(streamed.handles);
+    free(searchData);
+    free(found);
+    VSSFreeTree(root);
+    return failed;
+}
+
+/**
+* Times the lookup of every node path with an exact VSSSearchNodes(), with VSSLookupPath() without and with the path index,
+* and with a case-insensitive VSSLookupPath(), and checks that they find the same nodes.
+**/
+static int benchLookup(char* fname) {
+    struct timespec start, end;
+    long walkRoot = loadQuiet(fname, VSS_LOAD_DEFAULT);
+    long indexRoot = loadQuiet(fname, VSS_LOAD_PATHINDEX | VSS_LOAD_COMPACT);
+    if (walkRoot == 0 || indexRoot == 0) {
+        return 1;
+    }
+    int numOfPaths = VSSGetCompactTree(indexRoot)->nodeCount;
+    searchData_t* paths = (searchData_t*) malloc(sizeof(searchData_t)*numOfPaths);
+    searchData_t ancestors[MAXCHARSPATH/2];
+    if (paths == NULL) {
+        return 1;
+    }
+    VSSSearchNodes("Vehicle.*", indexRoot, numOfPaths, paths, true, false, 0, NULL, NULL);
+    int failed = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0 ; i < numOfPaths ; i++) {
+        int matches = VSSSearchNodes(paths[i].responsePaths, indexRoot, MAXCHARSPATH/2, ancestors, false, false, 0, NULL, NULL);
+        failed |= matches == 0 || ancestors[matches-1].foundNodeHandles != paths[i].foundNodeHandles;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double searchUs = elapsedMs(&start, &end) * 1000 / numOfPaths;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0 ; i < numOfPaths ; i++) {
+        failed |= VSSgetIndex(VSSLookupPath(walkRoot, paths[i].responsePaths, false)) != VSSgetIndex(paths[i].foundNodeHandles);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double walkUs = elapsedMs(&start, &end) * 1000 / numOfPaths;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0 ; i < numOfPaths ; i++) {
+        failed |= VSSLookupPath(indexRoot, paths[i].responsePaths, false) != paths[i].foundNodeHandles;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double indexUs = elapsedMs(&start, &end) * 1000 / numOfPaths;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0 ; i < numOfPaths ; i++) {
+        failed |= VSSLookupPath(indexRoot, paths[i].responsePaths, true) != paths[i].foundNodeHandles;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double foldedUs = elapsedMs(&start, &end) * 1000 / numOfPaths;
+    printf("Lookup of %d paths: VSSSearchNodes %.3f us, walk %.3f us, path index %.3f us, case-insensitive %.3f us (speedup %.1fx)%s\n",
+           numOfPaths, searchUs, walkUs, indexUs, foldedUs, searchUs / indexUs, failed ? ", RESULTS DIFFER" : "");
+    free(paths);
+    VSSFreeTree(walkRoot);
+    VSSFreeTree(indexRoot);
+    return failed;
+}
+
+static int countBatchMatch(int pathNo, long nodeHandle, void* userData) {
+    (void)nodeHandle;
+    ((int*)userData)[pathNo]++;
+    return 0;
+}
+
+static int countMatch(long nodeHandle, void* userData) {
+    (void)nodeHandle;
+    (*(int*)userData)++;
+    return 0;
+}
+
+/**
+* Searches BATCHPATHS paths, which are leaf paths spread over the tree and one subtree wildcard path per branch two levels down,
+* with one VSSSearchNodes() or VSSSearchStream() call per path, and with one VSSSearchBatch(), and checks that the match counts are the same.
+**/
+static int benchBatch(char* fname) {
+    struct timespec start, end;
+    long root = loadQuiet(fname, VSS_LOAD_COMPACT);
+    if (root == 0) {
+        return 1;
+    }
+    int nodeCount = VSSGetCompactTree(root)->nodeCount;
+    searchData_t* searchData = (searchData_t*) malloc(sizeof(searchData_t)*nodeCount);
+    char** paths = (char**) malloc(sizeof(char*)*BATCHPATHS);
+    int* counts = (int*) calloc(BATCHPATHS, sizeof(int));
+    int* batchCounts = (int*) calloc(BATCHPATHS, sizeof(int));
+    if (searchData == NULL || paths == NULL || counts == NULL || batchCounts == NULL) {
+        return 1;
+    }
+    int numOfPaths = 0;
+    int numOfNodes = VSSSearchNodes("Vehicle.*", root, nodeCount, searchData, true, false, 0, NULL, NULL);
+    for (int i = 0 ; i < numOfNodes && numOfPaths < BATCHPATHS ; i++) {
+        char* path = searchData[i].responsePaths;
+        char* delim = strchr(path, '.');
+        bool secondLevel = delim != NULL && strchr(delim + 1, '.') != NULL && strchr(strchr(delim + 1, '.') + 1, '.') == NULL;
+        if (secondLevel == true || (VSSgetNumOfChildren(searchData[i].foundNodeHandles) == 0 && i % (numOfNodes / (BATCHPATHS / 2)) == 0)) {
+            paths[numOfPaths] = (char*) malloc(strlen(path) + 3);
+            sprintf(paths[numOfPaths++], secondLevel == true ? "%s.*" : "%s", path);
+        }
+    }
+    int failed = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0 ; i < numOfPaths ; i++) {
+        counts[i] = VSSSearchNodes(paths[i], root, nodeCount, searchData, true, true, 0, NULL, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double searchMs = elapsedMs(&start, &end);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0 ; i < numOfPaths ; i++) {
+        int streamed = 0;
+        vssPattern_t* pattern = VSSCompilePattern(paths[i]);
+        VSSSearchStream(pattern, root, true, true, 0, NULL, countMatch, &streamed, NULL);
+        VSSFreePattern(pattern);
+        failed |= streamed != counts[i];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double streamMs = elapsedMs(&start, &end);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    vssBatch_t* batch = VSSCompileBatch(paths, numOfPaths);
+    int batchMatches = VSSSearchBatch(batch, root, true, true, countBatchMatch, batchCounts);
+    VSSFreeBatch(batch);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double batchMs = elapsedMs(&start, &end);
+    int totalMatches = 0;
+    for (int i = 0 ; i < numOfPaths ; i++) {
+        failed |= batchCounts[i] != counts[i];
+        totalMatches += counts[i];
+        free(paths[i]);
+    }
+    failed |= batchMatches != totalMatches;
+    printf("Batch of %d paths, %d matches: VSSSearchNodes per path %.2f ms, VSSSearchStream per path %.2f ms, VSSSearchBatch %.2f ms (speedup %.1fx)%s\n",
+           numOfPaths, totalMatches, searchMs, streamMs, batchMs, searchMs / batchMs, failed ? ", RESULTS DIFFER" : "");
+    free(paths);
+    free(counts);
+    free(batchCounts);
+    free(searchData);
+    VSSFreeTree(root);
+    return failed;
+}
+
+/**
+* Checks one value per leaf against the min and max of its node, with strtod() of the min and max strings per value as done before they
+* were parsed at load, with VSSCheckRange() per value, and with one VSSCheckRangeBatch(), and checks that the results are the same.
+**/
+static int benchRange(char* fname, int iterations) {
+    struct timespec start, end;
+    long root = loadQuiet(fname, VSS_LOAD_COMPACT);
+    if (root == 0) {
+        return 1;
+    }
+    int nodeCount = VSSGetCompactTree(root)->nodeCount;
+    streamResult_t leaves = {(long*) malloc(sizeof(long)*nodeCount), 0};
+    double* values = (double*) malloc(sizeof(double)*nodeCount);
+    uint8_t* results = (uint8_t*) malloc(sizeof(uint8_t)*nodeCount);
+    vssPattern_t* pattern = VSSCompilePattern("Vehicle.*");
+    if (leaves.handles == NULL || values == NULL || results == NULL || pattern == NULL) {
+        return 1;
+    }
+    VSSSearchStream(pattern, root, true, true, 0, NULL, saveHandle, &leaves, NULL);
+    VSSFreePattern(pattern);
+    for (int i = 0 ; i < leaves.numOfMatches ; i++) {
+        values[i] = (double)(i % 120) - 10;  // the synthetic sensors have min 0 and max 100
+    }
+    int outOfRange[3] = {0, 0, 0};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int iter = 0 ; iter < iterations ; iter++) {
+        outOfRange[0] = 0;
+        for (int i = 0 ; i < leaves.numOfMatches ; i++) {
+            node_t* node = (node_t*)((intptr_t)leaves.handles[i]);
+            outOfRange[0] += (node->min != NULL && values[i] < strtod(node->min, NULL)) || (node->max != NULL && values[i] > strtod(node->max, NULL));
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double parseNs = elapsedMs(&start, &end) * 1e6 / iterations / leaves.numOfMatches;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int iter = 0 ; iter < iterations ; iter++) {
+        outOfRange[1] = 0;
+        for (int i = 0 ; i < leaves.numOfMatches ; i++) {
+            outOfRange[1] += VSSCheckRange(leaves.handles[i], values[i]) != VSS_IN_RANGE;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double checkNs = elapsedMs(&start, &end) * 1e6 / iterations / leaves.numOfMatches;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int iter = 0 ; iter < iterations ; iter++) {
+        outOfRange[2] = VSSCheckRangeBatch(leaves.handles, values, leaves.numOfMatches, results);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double batchNs = elapsedMs(&start, &end) * 1e6 / iterations / leaves.numOfMatches;
+    int failed = outOfRange[0] != outOfRange[1] || outOfRange[0] != outOfRange[2];
+    printf("Range check of %d values, %d out of range: strtod %.1f ns, VSSCheckRange %.1f ns, VSSCheckRangeBatch %.1f ns per value (speedup %.1fx)%s\n",
+           leaves.numOfMatches, outOfRange[0], parseNs, checkNs, batchNs, parseNs / batchNs, failed ? ", RESULTS DIFFER" : "");
+    free(leaves.handles);
+    free(values);
+    free(results);
+    VSSFreeTree(root);
+    return failed;
+}
+
+typedef struct benchSize_t {
+    char* label;
+    int branchFanout;  // of the root and of its branches, whose branches then carry leafFanout sensors each
+    int leafFanout;
+} benchSize_t;
+
+/**
+* Loads trees of about 10k, 100k and 1M nodes from both formats, and parses them with VSSParseStream().
+**/
+static int benchSizes(char* self) {
+    benchSize_t sizes[NUMOFSIZES] = {{"10k", 20, 24}, {"100k", 50, 39}, {"1M", 100, 99}};
+    char* v1File = "bench_parser_size_v1.binary";
+    char* v2File = "bench_parser_size_v2.binary";
+    int failed = 0;
+    for (int i = 0 ; i < NUMOFSIZES && failed == 0 ; i++) {
+        char label[32];
+        int nodes = writeSyntheticTree(v1File, 3, 1, sizes[i].branchFanout, sizes[i].leafFanout);
+        if (nodes < 0 || writeSyntheticTree(v2File, 3, 2, sizes[i].branchFanout, sizes[i].leafFanout) < 0) {
+            failed = 1;
+            break;
+        }
+        printf("%s tree, %d nodes, format 1 = %ld kB, format 2 = %ld kB\n", sizes[i].label, nodes, fileSizeKb(v1File), fileSizeKb(v2File));
+        snprintf(label, sizeof(label), "%s, format 1 read", sizes[i].label);
+        failed |= benchLoad(self, label, v1File, VSS_LOAD_DEFAULT, VSS_ATTR_ALL);
+        snprintf(label, sizeof(label), "%s, format 2 read", sizes[i].label);
+        failed |= benchLoad(self, label, v2File, VSS_LOAD_DEFAULT, VSS_ATTR_ALL);
+        snprintf(label, sizeof(label), "%s, format 1 stream", sizes[i].label);
+        failed |= benchStream(self, label, v1File);
+        snprintf(label, sizeof(label), "%s, format 2 stream", sizes[i].label);
+        failed |= benchStream(self, label, v2File);
+    }
+    remove(v1File);
+    remove(v2File);
+    return failed;
+}
+
+/**
+* Loads, searches with a trailing wildcard, and writes the deep tree, which checks that none of them recurses per tree level.
+**/
+static int benchDeep(char* fname, int nodes) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long root = loadQuiet(fname, VSS_LOAD_DEFAULT);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (root == 0) {
+        return 1;
+    }
+    double loadMs = elapsedMs(&start, &end);
+    int matches = 0;
+    vssPattern_t* pattern = VSSCompilePattern("Vehicle.*");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    VSSSearchStream(pattern, root, true, true, 0, NULL, countMatch, &matches, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double searchMs = elapsedMs(&start, &end);
+    VSSFreePattern(pattern);
+    VSSWriteTree("bench_parser_deep_v1.binary", root);
+    remove("bench_parser_deep_v1.binary");
+    VSSFreeTree(root);
+    int failed = matches != nodes / 2 + 1;
+    printf("Deep tree of %d levels: load %.1f ms, search %d leaves %.1f ms%s\n", DEEPLEVELS, loadMs, matches, searchMs, failed ? ", RESULTS DIFFER" : "");
+    return failed;
+}
+
+/**
+* Reports the bytes of each attribute class, which a load that drops the class does not store.
+**/
+static int benchAttributes(char* fname) {
+    const char* classNames[VSS_NUMOFATTRCLASSES] = {"uuid", "description", "unit", "min/max/default", "allowed"};
+    long root = VSSLoadTreeAttributes(fname, VSS_LOAD_QUIET, 0, NULL);
+    if (root == 0) {
+        return 1;
+    }
+    vssAttributeBytes_t bytes;
+    VSSGetAttributeBytes(root, &bytes);
+    printf("Attribute bytes dropped per class:");
+    for (int i = 0 ; i < VSS_NUMOFATTRCLASSES ; i++) {
+        printf("%s %s %lu kB", i == 0 ? "" : ",", classNames[i], (unsigned long)(bytes.dropped[i] / 1024));
+    }
+    printf("\n");
+    VSSFreeTree(root);
+    return 0;
+}
+
+/**
+* Reports the statistics that the library keeps of a load.
+**/
+static int benchStats(char* label, char* fname, int loadFlags) {
+    long root = VSSLoadTree(fname, loadFlags | VSS_LOAD_QUIET, NULL);
+    if (root == 0) {
+        return 1;
+    }
+    vssTreeStats_t stats;
+    VSSGetTreeStats(root, &stats);
+    printf("%s stats: %u nodes (%u branches, %u sensors, %u actuators, %u attributes), depth %u, %lu kB read, %lu allocations of %lu kB, %lu kB strings, load %.1f ms\n",
+           label, stats.totalNodes, stats.nodesPerType[BRANCH], stats.nodesPerType[SENSOR], stats.nodesPerType[ACTUATOR], stats.nodesPerType[ATTRIBUTE], stats.maxDepth,
+           (unsigned long)(stats.bytesRead / 1024), (unsigned long)stats.allocations, (unsigned long)(stats.allocatedBytes / 1024),
+           (unsigned long)(stats.stringPoolBytes / 1024), stats.loadNs / 1e6);
+    VSSFreeTree(root);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 6 && strcmp(argv[1], "load") == 0) {
+        return loadTree(argv[2], argv[3], atoi(argv[4]), atoi(argv[5]));
+    }
+    if (argc == 4 && strcmp(argv[1], "stream") == 0) {
+        return streamTree(argv[2], argv[3]);
+    }
+    int depth = argc > 1 ? atoi(argv[1]) : 5;
+    char* v1File = "bench_parser_v1.binary";
+    char* v2File = "bench_parser_v2.binary";
+    char* wideFile = "bench_parser_wide.binary";
+    char* deepFile = "bench_parser_deep.binary";
+
+    int nodes = writeSyntheticTree(v1File, depth, 1, BRANCHFANOUT, LEAFFANOUT);
+    if (nodes < 0 || writeSyntheticTree(v2File, depth, 2, BRANCHFANOUT, LEAFFANOUT) < 0 || writeSyntheticTree(wideFile, 2, 2, WIDEFANOUT, WIDEFANOUT) < 0) {
+        return 1;
+    }
+    int deepNodes = writeDeepTree(deepFile, DEEPLEVELS);
+    if (deepNodes < 0) {
+        return 1;
+    }
+    printf("Nodes loaded = %d\n", nodes);
+    printf("File size: format 1 = %ld kB, format 2 = %ld kB\n", fileSizeKb(v1File), fileSizeKb(v2File));
+    int failed = benchLoad(argv[0], "Format 1, read", v1File, VSS_LOAD_DEFAULT, VSS_ATTR_ALL);
+    failed |= benchLoad(argv[0], "Format 2, read", v2File, VSS_LOAD_DEFAULT, VSS_ATTR_ALL);
+    failed |= benchLoad(argv[0], "Format 2, mmap", v2File, VSS_LOAD_MMAP, VSS_ATTR_ALL);
+    failed |= benchLoad(argv[0], "Format 2, lazy", v2File, VSS_LOAD_LAZY, VSS_ATTR_ALL);
+    failed |= benchLoad(argv[0], "Format 2, lazy mmap", v2File, VSS_LOAD_LAZY | VSS_LOAD_MMAP, VSS_ATTR_ALL);
+    failed |= benchLoad(argv[0], "Format 1, minimal", v1File, VSS_LOAD_DEFAULT, VSS_ATTR_UNIT | VSS_ATTR_RANGE);
+    failed |= benchLoad(argv[0], "Format 2, minimal", v2File, VSS_LOAD_DEFAULT, VSS_ATTR_UNIT | VSS_ATTR_RANGE);
+    failed |= benchAttributes(v2File);
+    failed |= benchStats("Format 1, read", v1File, VSS_LOAD_DEFAULT);
+    failed |= benchStats("Format 2, mmap", v2File, VSS_LOAD_MMAP);
+    failed |= benchSizes(argv[0]);
+    path_t leafPath = "Vehicle";
+    for (int level = 1 ; level < depth ; level++) {
+        strcat(leafPath, ".Branch1");
+    }
+    strcat(leafPath, ".Signal5");
+    failed |= benchSearch(v2File, "Vehicle.*", true, 10);
+    failed |= benchSearch(v2File, "Vehicle.*.Branch1.*", true, 10);
+    failed |= benchSearch(v2File, leafPath, false, 1000);
+    failed |= benchLookup(v2File);
+    failed |= benchBatch(v2File);
+    failed |= benchRange(v2File, 10);
+    printf("Wide tree, %d children per branch:\n", WIDEFANOUT);
+    failed |= benchLookup(wideFile);
+    failed |= benchDeep(deepFile, deepNodes);
+    remove(v1File);
+    remove(v2File);
+    remove(wideFile);
+    remove(deepFile);
+    return failed == 0 ? 0 : 1;
+}
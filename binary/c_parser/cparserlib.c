@@ -12,47 +12,85 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <errno.h>
+#include <math.h>
+#include <float.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 #include "cparserlib.h"
 
-FILE* treeFp;
+/**
+ * There is no mutable global state, the state of a load is kept in the tree and the state of a search in its context,
+ * so that a tree can be searched by many threads concurrently.
+ **/
 
 typedef struct readTreeMetadata_t {
     int currentDepth;
     int maxTreeDepth;
     int totalNodes;
 } ReadTreeMetadata_t;
-ReadTreeMetadata_t readTreeMetadata;
 
-bool isGetLeafNodeList;
-bool isGetUuidList;
-
-int ret;  // to silence compiler...
+#define PENDINGBUFLEN 64
+#define NODESTACKBUFLEN 32  // tree levels that a walk of the tree can go down before its stack is allocated
+#define SEARCHSTACKBUFLEN 32
 
+/**
+ * Matches below a wildcard segment are pending until the speculation on the wildcard has succeeded, as a failed speculation removes the
+ * matches saved after the failing node was entered. The pending matches are passed to the callback when a speculation succeeds, which
+ * also decides the speculations of all nodes above it, or when no wildcard speculation is left, so that only matches on the path from
+ * the root to the node in focus can be pending.
+ **/
 typedef struct SearchContext_t {
 	long rootNode;
-	int maxFound;
 	bool leafNodesOnly;
 	int maxDepth;
-	char* searchPath;
-	path_t matchPath;
+	vssPattern_t* pattern;
+	path_t matchPath;  // path of the node in focus, built by isEndOfScope() only
 	int currentDepth;  // depth in tree from rootNode, and also depth (in segments) in searchPath
 	int speculationIndex;  // inc/dec when pathsegment in focus is wildcard
-	int speculativeMatches[20];  // inc when matching node is saved
 	int maxValidation;
-	int numOfMatches;
-	searchData_t* searchData;
+	int numOfSaved;    // matches saved, including the pending matches
+	int numOfMatches;  // matches passed to the callback
+	long* pending;     // the matches numOfMatches to numOfSaved-1
+	int pendingSize;
+	long pendingBuf[PENDINGBUFLEN];
+	vssMatchCallback_t callback;
+	void* userData;
+	bool stopped;      // by the callback or out of memory
+	bool outOfMemory;
 	int listSize;
 	noScopeList_t* noScopeList;
-	FILE* listFp;
 } SearchContext_t;
 
+#define MAXPATHSEGMENTS (MAXCHARSPATH/2)
+
+/**
+ * Holds the pattern of a search path that is compiled for one call only, on the stack unless the path has more than MAXPATHSEGMENTS segments.
+ **/
+typedef struct localPattern_t {
+	vssPattern_t pattern;
+	vssPatternSegment_t segments[MAXPATHSEGMENTS];
+	vssPattern_t* compiled;
+} localPattern_t;
+
+const vssPatternSegment_t wildcardSegment = {"*", 1, true};
+const vssPatternSegment_t emptySegment = {"", 0, false};
+
 // Access control values: none=0, write-only=1. read-write=2, consent +=10
 // matrix preserving inherited value with read-write having priority over write-only and consent over no consent
-uint8_t validationMatrix[5][5] = {{0,1,2,11,12}, {1,1,2,11,12}, {2,2,2,12,12}, {11,11,12,11,12}, {12,12,12,12,12}};
+const uint8_t validationMatrix[5][5] = {{0,1,2,11,12}, {1,1,2,11,12}, {2,2,2,12,12}, {11,11,12,11,12}, {12,12,12,12,12}};
 
 uint8_t getMaxValidation(uint8_t newValidation, uint8_t currentMaxValidation) {
 	return validationMatrix[translateToMatrixIndex(newValidation)][translateToMatrixIndex(currentMaxValidation)];
@@ -69,26 +107,159 @@ uint8_t translateToMatrixIndex(uint8_t index) {
 	return 0;
 }
 
-void initReadMetadata() {
-	readTreeMetadata.currentDepth = 0;
-	readTreeMetadata.maxTreeDepth = 0;
-	readTreeMetadata.totalNodes = 0;
-}
+/**
+ * All memory of a tree is allocated from the slabs of its arena, so that VSSFreeTree() releases the tree with one free() per slab.
+ **/
+#define ARENASLABSIZE (256*1024)
+#define ARENAALIGNMENT 16
+
+typedef struct arenaSlab_t {
+	struct arenaSlab_t* next;
+	size_t size;
+	size_t used;
+	_Alignas(ARENAALIGNMENT) char data[];
+} arenaSlab_t;
+
+/**
+ * Open addressing hash tables of the full paths of the nodes, one with the exact path as key, and one with the path folded to lower case.
+ * Slots hold the hash and the node index, and a probe is verified by comparing the path with the names on the way from the node to the root.
+ **/
+typedef struct pathSlot_t {
+	uint32_t hash;
+	uint32_t index;  // VSSNOINDEX if the slot is empty
+} pathSlot_t;
+
+typedef struct pathIndex_t {
+	uint32_t mask;  // number of slots - 1, the number of slots is a power of two
+	pathSlot_t* exact;
+	pathSlot_t* folded;
+	node_t** nodes;  // node of each index
+} pathIndex_t;
+
+/**
+ * Open addressing hash table of the strings of a tree that is read from a format version 1 file, which repeats e.g. the names, units
+ * and descriptions of instances in every node, so that every distinct string is kept once in the arena. It only exists during the load.
+ **/
+typedef struct stringTable_t {
+	char** strings;    // NULL if the slot is empty
+	uint32_t* hashes;
+	uint32_t mask;     // number of slots - 1, the number of slots is a power of two
+	uint32_t used;
+} stringTable_t;
 
-void updateReadMetadata(bool increment) {
+/**
+ * Nodes with the same datatype and the same min, max and default strings share their range. The strings of a load are shared,
+ * so equal strings have equal pointers, and the last range of each pointer hash is kept in a direct mapped cache.
+ **/
+#define RANGECACHESIZE 256
+
+typedef struct rangeCacheEntry_t {
+	const char* min;
+	const char* max;
+	const char* defaultAllowed;
+	uint8_t datatype;
+	vssRange_t* range;
+} rangeCacheEntry_t;
+
+/**
+ * The strings of a format version 2 tree. When verify is false the strings are not read at load time,
+ * which keeps untouched pages of a mapped file out of memory, and a pool that ends with a null terminator
+ * then guarantees that every string in it is terminated.
+ **/
+typedef struct stringPool_t {
+	char* buf;
+	uint32_t size;
+	uint32_t descrBase;  // the description references are relative to the start of the descriptions
+	bool verify;
+} stringPool_t;
+
+typedef struct vssTree_t {
+	arenaSlab_t* slabs;  // the first slab is the one that is currently filled
+	uint8_t* map;        // the file mapped by VSS_LOAD_MMAP, else NULL
+	size_t mapLen;
+	ReadTreeMetadata_t readTreeMetadata;
+	vssCompactTree_t* compact;  // built by VSS_LOAD_COMPACT, else NULL
+	pathIndex_t* pathIndex;     // built by VSS_LOAD_PATHINDEX, else NULL
+	stringTable_t* strings;     // during the load of a format version 1 file, else NULL
+	rangeCacheEntry_t* rangeCache;  // during the load, else NULL
+	const uint8_t* lazyRecords;  // node section of a VSS_LOAD_LAZY tree, else NULL
+	uint32_t lazyRecordsLen;
+	stringPool_t lazyPool;
+	pthread_mutex_t lazyLock;  // held while attributes are decoded after the load
+	int attributes;  // the vssAttributes_t classes that are kept
+	vssAttributeBytes_t attributeBytes;
+	vssTreeStats_t stats;  // totalNodes and maxDepth are those of readTreeMetadata
+	bool quiet;  // VSS_LOAD_QUIET
+} vssTree_t;
+
+void updateReadMetadata(vssTree_t* tree, bool increment) {
 	if (increment == true) {
-		readTreeMetadata.totalNodes++;
-		readTreeMetadata.currentDepth++;
-		if (readTreeMetadata.currentDepth > readTreeMetadata.maxTreeDepth)
-			readTreeMetadata.maxTreeDepth++;
+		tree->readTreeMetadata.totalNodes++;
+		tree->readTreeMetadata.currentDepth++;
+		if (tree->readTreeMetadata.currentDepth > tree->readTreeMetadata.maxTreeDepth)
+			tree->readTreeMetadata.maxTreeDepth++;
 	} else {
-		readTreeMetadata.currentDepth--;
+		tree->readTreeMetadata.currentDepth--;
+	}
+}
+
+void countNodeType(vssTree_t* tree, node_t* node) {
+	tree->stats.nodesPerType[node->type < VSS_NUMOFNODETYPES ? node->type : UNKNOWN]++;
+}
+
+void printReadMetadata(vssTree_t* tree) {
+	printf("\nTotal number of nodes in VSS tree = %d\n", tree->readTreeMetadata.totalNodes);
+	printf("Max depth of VSS tree = %d\n", tree->readTreeMetadata.maxTreeDepth);
+}
+
+void* arenaAlloc(vssTree_t* tree, size_t size) {
+	arenaSlab_t* slab = tree->slabs;
+	size_t start = 0;
+	if (slab != NULL) {
+		start = (slab->used + ARENAALIGNMENT-1) & ~(size_t)(ARENAALIGNMENT-1);
+	}
+	if (slab == NULL || start + size > slab->size) {
+		bool dedicated = size > ARENASLABSIZE/4;  // large allocations get a slab of their own, the current slab is kept for filling
+		size_t slabSize = dedicated == true ? size : ARENASLABSIZE;
+		slab = (arenaSlab_t*) malloc(sizeof(arenaSlab_t) + slabSize);
+		if (slab == NULL) {
+			return NULL;
+		}
+		slab->size = slabSize;
+		tree->stats.allocations++;
+		tree->stats.allocatedBytes += sizeof(arenaSlab_t) + slabSize;
+		if (dedicated == true && tree->slabs != NULL) {
+			slab->next = tree->slabs->next;
+			tree->slabs->next = slab;
+		} else {
+			slab->next = tree->slabs;
+			tree->slabs = slab;
+		}
+		start = 0;
+	}
+	slab->used = start + size;
+	return &slab->data[start];
+}
+
+void* arenaCalloc(vssTree_t* tree, size_t size) {
+	void* mem = arenaAlloc(tree, size);
+	if (mem != NULL) {
+		memset(mem, 0, size);
 	}
+	return mem;
 }
 
-void printReadMetadata() {
-	printf("\nTotal number of nodes in VSS tree = %d\n", readTreeMetadata.totalNodes);
-	printf("Max depth of VSS tree = %d\n", readTreeMetadata.maxTreeDepth);
+void freeTree(vssTree_t* tree) {
+	while (tree->slabs != NULL) {
+		arenaSlab_t* next = tree->slabs->next;
+		free(tree->slabs);
+		tree->slabs = next;
+	}
+	if (tree->map != NULL) {
+		munmap(tree->map, tree->mapLen);
+	}
+	pthread_mutex_destroy(&tree->lazyLock);
+	free(tree);
 }
 
 nodeTypes_t stringToNodeType(char* type) {
@@ -104,7 +275,6 @@ nodeTypes_t stringToNodeType(char* type) {
         return STRUCT;
     if (strcmp(type, "property") == 0)
         return PROPERTY;
-    printf("Unknown type! |%s|\n", type);
     return UNKNOWN;
 }
 
@@ -139,6 +309,7 @@ uint8_t validateToUint8(char* validate) {
 }
 
 void validateToString(uint8_t validate, char *validation) {
+    validation[0] = '\0';
     if (validate%10 == 1) {
         strcpy(validation, "write-only");
     } else if (validate%10 == 2) {
@@ -149,80 +320,310 @@ void validateToString(uint8_t validate, char *validation) {
     }
 }
 
-void pushPathSegment(char* name, SearchContext_t* context) {
-	if (context->currentDepth > 0) {
-		strcat(context->matchPath, ".");
+/**
+ * Names of the primitive datatypes, in vssDatatype_t order from VSS_DATATYPE_INT8.
+ **/
+static const char* datatypeNames[] = {"int8", "uint8", "int16", "uint16", "int32", "uint32", "int64", "uint64", "boolean", "float", "double", "string"};
+
+uint8_t datatypeToCode(const char* datatype, uint32_t len) {
+	if (len == 0) {
+		return VSS_DATATYPE_NONE;
+	}
+	uint8_t arrayFlag = 0;
+	if (len > 2 && datatype[len-2] == '[' && datatype[len-1] == ']') {
+		arrayFlag = VSS_DATATYPE_ARRAY;
+		len -= 2;
+	}
+	for (uint32_t i = 0 ; i < sizeof(datatypeNames)/sizeof(datatypeNames[0]) ; i++) {
+		if (strlen(datatypeNames[i]) == len && memcmp(datatypeNames[i], datatype, len) == 0) {
+			return (uint8_t)(VSS_DATATYPE_INT8 + i) | arrayFlag;
+		}
 	}
-	strcat(context->matchPath, name);
+	return VSS_DATATYPE_STRUCT | arrayFlag;
 }
 
-void popPathSegment(SearchContext_t* context) {
-	char* delim = strrchr(context->matchPath, '.');
-	if (delim == NULL) {
-		context->matchPath[0] = 0;
-	} else {
-		*delim = 0;
+/**
+ * parseValue() parses a min, max or default string as a value of the base datatype, and returns false if it is not one,
+ * which includes an integer outside the width of its datatype, and a NaN, an infinity or a float beyond FLT_MAX.
+ **/
+#define MAXVALUELEN 63
+
+bool parseValue(const char* str, uint32_t len, uint8_t datatype, vssValue_t* value) {
+	char buf[MAXVALUELEN+1];
+	if (len == 0 || len > MAXVALUELEN) {
+		return false;
 	}
+	memcpy(buf, str, len);  // format version 2 strings are not terminated at len in a mapped file that is not verified
+	buf[len] = '\0';
+	char* end = buf;
+	errno = 0;
+	switch (datatype) {
+	case VSS_DATATYPE_INT8: case VSS_DATATYPE_INT16: case VSS_DATATYPE_INT32: case VSS_DATATYPE_INT64: {
+		int bits = 8 << ((datatype - VSS_DATATYPE_INT8) / 2);
+		value->i = strtoll(buf, &end, 10);
+		if (bits < 64 && (value->i < -(INT64_C(1) << (bits - 1)) || value->i >= (INT64_C(1) << (bits - 1)))) {
+			return false;
+		}
+		break;
+	}
+	case VSS_DATATYPE_UINT8: case VSS_DATATYPE_UINT16: case VSS_DATATYPE_UINT32: case VSS_DATATYPE_UINT64: {
+		int bits = 8 << ((datatype - VSS_DATATYPE_INT8) / 2);
+		if (strchr(buf, '-') != NULL) {  // strtoull() accepts and negates it
+			return false;
+		}
+		value->u = strtoull(buf, &end, 10);
+		if (bits < 64 && value->u >= (UINT64_C(1) << bits)) {
+			return false;
+		}
+		break;
+	}
+	case VSS_DATATYPE_FLOAT: case VSS_DATATYPE_DOUBLE:
+		value->f = strtod(buf, &end);
+		if (isfinite(value->f) == 0 || (datatype == VSS_DATATYPE_FLOAT && fabs(value->f) > FLT_MAX)) {
+			return false;
+		}
+		break;
+	case VSS_DATATYPE_BOOLEAN:
+		value->u = strcmp(buf, "true") == 0;
+		return value->u == 1 || strcmp(buf, "false") == 0;
+	default:
+		return false;
+	}
+	return end != buf && *end == '\0' && errno == 0;
 }
 
-void incDepth(long thisNode, SearchContext_t* context) {
-	pushPathSegment(VSSgetName(thisNode), context);
-	context->currentDepth++;
+double valueToDouble(vssValue_t value, uint8_t datatype) {
+	if (datatype >= VSS_DATATYPE_INT8 && datatype <= VSS_DATATYPE_UINT64) {
+		return (datatype - VSS_DATATYPE_INT8) % 2 == 0 ? (double)value.i : (double)value.u;
+	}
+	return datatype == VSS_DATATYPE_BOOLEAN ? (double)value.u : value.f;
 }
 
-char getPathSegmentBuf[100];  // modified by getPathSegment() only
-char* getPathSegment(int offset, SearchContext_t* context) {
-	char* frontDelimiter = &(context->searchPath[0]);
-	char* endDelimiter;
-	for (int i = 1 ; i < context->currentDepth + offset ; i++) {
-		frontDelimiter = strchr(frontDelimiter+1, '.');
-		if (frontDelimiter == NULL) {
-			if (context->searchPath[strlen(context->searchPath)-1] == '*' && context->currentDepth < context->maxDepth) {
-				return "*";
-			} else {
-				return "";
-			}
+/**
+ * parseRange() sets the range of the node from its min, max and default strings, so that range checks do not parse them.
+ * A zeroed cache entry is a node without datatype and strings, which has no range.
+ **/
+int parseRange(vssTree_t* tree, node_t* node) {
+	rangeCacheEntry_t* cached = NULL;
+	if (tree->rangeCache != NULL) {
+		uintptr_t hash = ((uintptr_t)node->min >> 4) ^ ((uintptr_t)node->max >> 6) ^ ((uintptr_t)node->defaultAllowed >> 8) ^ node->datatypeCode;
+		cached = &tree->rangeCache[hash % RANGECACHESIZE];
+		if (cached->min == node->min && cached->max == node->max && cached->defaultAllowed == node->defaultAllowed && cached->datatype == node->datatypeCode) {
+			node->range = cached->range;
+			return VSS_OK;
+		}
+	}
+	vssRange_t range = {{0}, {0}, {0}, 0, 0, 0};
+	uint8_t datatype = node->datatypeCode;  // arrays have the flag set, and are not parsed
+	if (parseValue(node->min, node->minLen, datatype, &range.min) == true) {
+		range.flags |= VSS_HAS_MIN;
+	}
+	if (parseValue(node->max, node->maxLen, datatype, &range.max) == true) {
+		range.flags |= VSS_HAS_MAX;
+	}
+	if (parseValue(node->defaultAllowed, node->defaultLen, datatype, &range.defaultValue) == true) {
+		range.flags |= VSS_HAS_DEFAULT;
+	}
+	if (range.flags != 0) {
+		range.lowerBound = (range.flags & VSS_HAS_MIN) != 0 ? valueToDouble(range.min, datatype) : -HUGE_VAL;
+		range.upperBound = (range.flags & VSS_HAS_MAX) != 0 ? valueToDouble(range.max, datatype) : HUGE_VAL;
+		node->range = (vssRange_t*) arenaAlloc(tree, sizeof(vssRange_t));
+		if (node->range == NULL) {
+			return VSS_ERR_NOMEM;
 		}
+		*node->range = range;
+	}
+	if (cached != NULL) {
+		rangeCacheEntry_t entry = {node->min, node->max, node->defaultAllowed, node->datatypeCode, node->range};
+		*cached = entry;
 	}
-	endDelimiter = strchr(frontDelimiter+1, '.');
-	if (endDelimiter == NULL) {
-		endDelimiter = &(context->searchPath[strlen(context->searchPath)]);
+	return VSS_OK;
+}
+
+void incDepth(SearchContext_t* context) {
+	context->currentDepth++;
+}
+
+/**
+ * Returns the pattern segment at the current depth plus offset. Beyond the last segment a trailing wildcard matches any name down to maxDepth.
+ **/
+const vssPatternSegment_t* getPathSegment(int offset, SearchContext_t* context) {
+	int segmentNo = context->currentDepth + offset - 1;
+	if (segmentNo < context->pattern->numOfSegments) {
+		return &(context->pattern->segments[segmentNo]);
 	}
-	if (frontDelimiter[0] == '.') {
-		frontDelimiter++;
+	if (context->pattern->trailingWildcard == true && context->currentDepth < context->maxDepth) {
+		return &wildcardSegment;
 	}
-	strncpy(getPathSegmentBuf, frontDelimiter, (int)(endDelimiter-frontDelimiter));
-	getPathSegmentBuf[(int)(endDelimiter-frontDelimiter)] = 0;
-	return getPathSegmentBuf;
+	return &emptySegment;
 }
 
-int countSegments(char* path) {
-	int i;
-	if (strlen(path) == 0) {
+int countSegments(const char* path) {
+	if (path[0] == '\0') {
 		return 0;
 	}
-	char* delim = strchr(path, '.');
-	for (i = 0 ; i < 100 ; i++) {
-		if (delim == NULL) {
-			break;
+	int count = 1;
+	for (const char* delim = strchr(path, '.') ; delim != NULL ; delim = strchr(delim+1, '.')) {
+		count++;
+	}
+	return count;
+}
+
+void splitPattern(vssPattern_t* pattern, char* path, vssPatternSegment_t* segments, int numOfSegments) {
+	const char* segment = path;
+	for (int i = 0 ; i < numOfSegments ; i++) {
+		const char* delim = strchr(segment, '.');
+		segments[i].name = segment;
+		segments[i].len = delim != NULL ? (uint32_t)(delim - segment) : (uint32_t)strlen(segment);
+		segments[i].wildcard = segments[i].len == 1 && segment[0] == '*';
+		segment = delim != NULL ? delim + 1 : segment;
+	}
+	pattern->numOfSegments = numOfSegments;
+	pattern->trailingWildcard = numOfSegments > 0 && segments[numOfSegments-1].wildcard == true;
+	pattern->segments = segments;
+	pattern->path = path;
+}
+
+vssPattern_t* compileLocalPattern(localPattern_t* local, char* searchPath) {
+	int numOfSegments = countSegments(searchPath);
+	local->compiled = NULL;
+	if (numOfSegments > MAXPATHSEGMENTS) {
+		local->compiled = VSSCompilePattern(searchPath);
+		return local->compiled;
+	}
+	splitPattern(&(local->pattern), searchPath, local->segments, numOfSegments);
+	return &(local->pattern);
+}
+
+bool compareNodeName(long thisNode, const vssPatternSegment_t* segment) {
+	node_t* node = (node_t*)((intptr_t)thisNode);
+	return segment->wildcard == true || (node->nameLen == segment->len && memcmp(node->name, segment->name, segment->len) == 0);
+}
+
+#define SORTEDCHILDMIN 8  // with fewer children a scan of the names is as fast as a binary search
+
+int compareChildNames(const void* a, const void* b) {
+	const node_t* node1 = *(node_t* const*)a;
+	const node_t* node2 = *(node_t* const*)b;
+	if (node1->nameLen != node2->nameLen) {
+		return node1->nameLen < node2->nameLen ? -1 : 1;
+	}
+	int cmp = memcmp(node1->name, node2->name, node1->nameLen);
+	if (cmp != 0) {
+		return cmp;
+	}
+	return node1->index < node2->index ? -1 : 1;  // children with the same name keep their pre-order
+}
+
+/**
+ * A node with at least SORTEDCHILDMIN children also gets its children sorted by name length and name, so that a name is found by a binary search.
+ * If the memory for it cannot be allocated sortedChild stays NULL and the children are scanned.
+ **/
+void sortChildren(vssTree_t* tree, node_t* node) {
+	node->sortedChild = NULL;
+	if (node->children < SORTEDCHILDMIN) {
+		return;
+	}
+	node->sortedChild = (node_t**) arenaAlloc(tree, sizeof(node_t*)*node->children);
+	if (node->sortedChild != NULL) {
+		memcpy(node->sortedChild, node->child, sizeof(node_t*)*node->children);
+		qsort(node->sortedChild, node->children, sizeof(node_t*), compareChildNames);
+	}
+}
+
+/**
+ * Returns the position in sortedChild of the first child with the name, or the number of children if there is none.
+ **/
+uint32_t findSortedChild(node_t* node, const char* name, uint32_t len) {
+	uint32_t low = 0;
+	uint32_t high = node->children;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		node_t* child = node->sortedChild[middle];
+		if (child->nameLen < len || (child->nameLen == len && memcmp(child->name, name, len) < 0)) {
+			low = middle + 1;
+		} else {
+			high = middle;
 		}
-		delim = strchr(delim+1, '.');
 	}
-	return i+1;
+	if (low < node->children && (node->sortedChild[low]->nameLen != len || memcmp(node->sortedChild[low]->name, name, len) != 0)) {
+		return node->children;
+	}
+	return low;
 }
 
-bool compareNodeName(char* nodeName, char* pathName) {
-	if (strcmp(nodeName, pathName) == 0 || strcmp(pathName, "*") == 0) {
-		return true;
+#define SORTEDALLOWEDMIN 8  // with fewer allowed values a scan is as fast as a binary search
+
+int compareAllowed(const void* a, const void* b) {
+	const vssAllowed_t* allowed1 = *(vssAllowed_t* const*)a;
+	const vssAllowed_t* allowed2 = *(vssAllowed_t* const*)b;
+	if (allowed1->len != allowed2->len) {
+		return allowed1->len < allowed2->len ? -1 : 1;
 	}
-	return false;
+	int cmp = memcmp(allowed1->value, allowed2->value, allowed1->len);
+	if (cmp != 0) {
+		return cmp;
+	}
+	return allowed1 < allowed2 ? -1 : 1;  // equal values keep their ordinal order
+}
+
+/**
+ * Like the children, the allowed values of a node with at least SORTEDALLOWEDMIN of them are also sorted, by length and value.
+ * The ordinal of a sorted value is its position in allowedDef.
+ **/
+int sortAllowed(vssTree_t* tree, node_t* node) {
+	node->allowedSorted = NULL;
+	if (node->allowed < SORTEDALLOWEDMIN) {
+		return VSS_OK;
+	}
+	node->allowedSorted = (vssAllowed_t**) arenaAlloc(tree, sizeof(vssAllowed_t*)*node->allowed);
+	if (node->allowedSorted == NULL) {
+		return VSS_ERR_NOMEM;
+	}
+	for (uint32_t i = 0 ; i < node->allowed ; i++) {
+		node->allowedSorted[i] = &node->allowedDef[i];
+	}
+	qsort(node->allowedSorted, node->allowed, sizeof(vssAllowed_t*), compareAllowed);
+	return VSS_OK;
+}
+
+/**
+ * Returns the ordinal of the value, or -1 if it is not allowed.
+ **/
+int findAllowed(node_t* node, const char* value, uint32_t len) {
+	if (node->allowedSorted == NULL) {
+		for (uint32_t i = 0 ; i < node->allowed ; i++) {
+			if (node->allowedDef[i].len == len && memcmp(node->allowedDef[i].value, value, len) == 0) {
+				return (int)i;
+			}
+		}
+		return -1;
+	}
+	uint32_t low = 0;
+	uint32_t high = node->allowed;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		vssAllowed_t* allowed = node->allowedSorted[middle];
+		if (allowed->len < len || (allowed->len == len && memcmp(allowed->value, value, len) < 0)) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if (low == node->allowed || node->allowedSorted[low]->len != len || memcmp(node->allowedSorted[low]->value, value, len) != 0) {
+		return -1;
+	}
+	return (int)(node->allowedSorted[low] - node->allowedDef);
 }
 
-bool isEndOfScope(SearchContext_t* context) {
+bool isEndOfScope(long thisNode, SearchContext_t* context) {
     int i;
     if (context->listSize == 0) {
         return false;
     }
+    if (VSSGetPath(thisNode, context->rootNode, context->matchPath, MAXCHARSPATH) < 0) {
+        return false;
+    }
     for (i = 0 ; i < context->listSize ; i++) {
         char* noScopePath = context->noScopeList[i].path;
         if (strcmp(context->matchPath, noScopePath) == 0) {
@@ -232,87 +633,84 @@ bool isEndOfScope(SearchContext_t* context) {
     return false;
 }
 
+void savePending(long thisNode, SearchContext_t* context) {
+	int pendingLen = context->numOfSaved - context->numOfMatches;
+	if (pendingLen == context->pendingSize) {
+		long* pending = (long*) malloc(sizeof(long)*2*context->pendingSize);
+		if (pending == NULL) {
+			context->outOfMemory = true;
+			context->stopped = true;
+			return;
+		}
+		memcpy(pending, context->pending, sizeof(long)*pendingLen);
+		if (context->pending != context->pendingBuf) {
+			free(context->pending);
+		}
+		context->pending = pending;
+		context->pendingSize *= 2;
+	}
+	context->pending[pendingLen] = thisNode;
+	context->numOfSaved++;
+}
+
+void flushPending(SearchContext_t* context) {
+	int pendingLen = context->numOfSaved - context->numOfMatches;
+	for (int i = 0 ; i < pendingLen && context->stopped == false ; i++) {
+		context->numOfMatches++;
+		if (context->callback(context->pending[i], context->userData) != 0) {
+			context->stopped = true;
+		}
+	}
+	context->numOfSaved = context->numOfMatches;
+}
+
 int saveMatchingNode(long thisNode, SearchContext_t* context, bool* done) {
-	if (strcmp(getPathSegment(0, context), "*") == 0) {
+	if (getPathSegment(0, context)->wildcard == true) {
 		context->speculationIndex++;
 	}
 	context->maxValidation = getMaxValidation(VSSgetValidation(thisNode), context->maxValidation);
 	if (VSSgetType(thisNode) != BRANCH && VSSgetType(thisNode) != STRUCT || context->leafNodesOnly == false) {
-		if ( isGetLeafNodeList == false && isGetUuidList == false) {
-			strcpy(context->searchData[context->numOfMatches].responsePaths, context->matchPath);
-			context->searchData[context->numOfMatches].foundNodeHandles = thisNode;
-		} else {
-			if (isGetLeafNodeList == true) {
-			    if (context->numOfMatches == 0) {
-				    fwrite("\"", 1, 1, context->listFp);
-			    } else {
-				    fwrite(", \"", 3, 1, context->listFp);
-			    }
-			    fwrite(context->matchPath, strlen(context->matchPath), 1, context->listFp);
-			    fwrite("\"", 1, 1, context->listFp);
-			} else {
-			    if (context->numOfMatches == 0) {
-				    fwrite("{\"", 2, 1, context->listFp);
-			    } else {
-				    fwrite(", {\"", 4, 1, context->listFp);
-			    }
-			    fwrite(context->matchPath, strlen(context->matchPath), 1, context->listFp);
-			    fwrite("\", \"", 4, 1, context->listFp);
-			    char uuid[32+1];
-			    strcpy(uuid, VSSgetUUID(thisNode));
-			    fwrite(uuid, strlen(uuid), 1, context->listFp);
-			    fwrite("\"}", 2, 1, context->listFp);
-			}
-		}
-		context->numOfMatches++;
-		if (context->speculationIndex >= 0) {
-			context->speculativeMatches[context->speculationIndex]++;
+		savePending(thisNode, context);
+		if (context->speculationIndex < 0) {
+			flushPending(context);
 		}
 	}
-	if (VSSgetNumOfChildren(thisNode) == 0 || context->currentDepth == context->maxDepth || isEndOfScope(context) == true) {
+	if (VSSgetNumOfChildren(thisNode) == 0 || context->currentDepth == context->maxDepth || isEndOfScope(thisNode, context) == true) {
 		*done = true;
 	} else {
 		*done = false;
 	}
-	if (context->speculationIndex >= 0 && ((VSSgetNumOfChildren(thisNode) == 0 && context->currentDepth >= countSegments(context->searchPath)) || context->currentDepth == context->maxDepth)) {
+	if (context->speculationIndex >= 0 && ((VSSgetNumOfChildren(thisNode) == 0 && context->currentDepth >= context->pattern->numOfSegments) || context->currentDepth == context->maxDepth)) {
+		flushPending(context);  // the speculations of all nodes above have now succeeded
 		return 1;
 	}
 	return 0;
 }
 
 /**
- * decDepth() shall reverse speculative wildcard matches that have failed, and also decrement currentDepth.
+ * decDepth() shall remove the matches saved since the node was entered if its wildcard speculation has failed, and also decrement currentDepth.
  **/
-void decDepth(int speculationSucceded, SearchContext_t* context) {
-	if (context->speculationIndex >= 0 && context->speculativeMatches[context->speculationIndex] > 0) {
-		if (speculationSucceded == 0) {  // it failed so remove a saved match
-			context->numOfMatches--;
-			context->speculativeMatches[context->speculationIndex]--;
-		}
+void decDepth(int speculationSucceded, int numOfSavedBefore, SearchContext_t* context) {
+	if (context->speculationIndex >= 0 && speculationSucceded == 0 && context->stopped == false) {
+		context->numOfSaved = numOfSavedBefore;
 	}
-	if (strcmp(getPathSegment(0, context), "*") == 0) {
+	if (getPathSegment(0, context)->wildcard == true) {
 		context->speculationIndex--;
 	}
-	popPathSegment(context);
 	context->currentDepth--;
+	if (context->speculationIndex < 0) {
+		flushPending(context);
+	}
 }
 
-int hexToInt(char hexDigit) {
-    if (hexDigit <= '9') {
+int hexToInt(char hexDigit) {  // -1 if it is not a hex digit
+    if (hexDigit >= '0' && hexDigit <= '9') {
         return (int)(hexDigit - '0');
     }
-    return (int)(hexDigit - 'A' + 10);
-}
-
-int countAllowedElements(char* allowedStr) {  // allowed string has format "XXallowed1XXallowed2...XXallowedx", where XX are hex values; X=[0-9,A-F]
-    int allowed = 0;
-    for (int index = 0 ; index < strlen(allowedStr) ; ) {
-        char* hexLen = &(allowedStr[index]);
-        int allowedLen = hexToInt(hexLen[0]) * 16 + hexToInt(hexLen[1]);
-        index += allowedLen + 2;
-        allowed++;
+    if (hexDigit >= 'A' && hexDigit <= 'F') {
+        return (int)(hexDigit - 'A' + 10);
     }
-    return allowed;
+    return -1;
 }
 
 char hexDigit(int value) {
@@ -322,8 +720,7 @@ char hexDigit(int value) {
     return (char)(value - 10 + 'A');
 }
 
-char hexVal[3];  // only used by intToHex
-char* intToHex(int intVal) {
+char* intToHex(int intVal, char* hexVal) {  // hexVal must hold 3 chars
     if (intVal > 255) {
         return NULL;
     }
@@ -333,129 +730,336 @@ char* intToHex(int intVal) {
     return hexVal;
 }
 
-allowed_t allowedElement;  // only used by extractAllowedElement
-char* extractAllowedElement(char* allowedBuf, int elemIndex) {
-    int allowedstart;
-    int allowedLen;
-    int bufIndex = 0;
-    for (int alloweds = 0 ; alloweds <= elemIndex ; alloweds++) {
-        char* hexLen = &(allowedBuf[bufIndex]);
-        allowedLen = hexToInt(hexLen[0]) * 16 + hexToInt(hexLen[1]);
-        allowedstart = bufIndex + 2;
-        bufIndex += allowedLen + 2;
-    }
-    strncpy(allowedElement, &(allowedBuf[allowedstart]), allowedLen);
-    allowedElement[allowedLen] = 0;
-    return (char*)&allowedElement;
-}
-
-void populateNode(node_t* thisNode) {
-	ret = fread(&(thisNode->nameLen), sizeof(uint8_t), 1, treeFp);
-	thisNode->name = (char*) malloc(sizeof(char)*(thisNode->nameLen+1));
-	ret = fread(thisNode->name, sizeof(char)*thisNode->nameLen, 1, treeFp);
-	thisNode->name[thisNode->nameLen] = '\0';
-
-	uint8_t typeLen;
-	ret = fread(&typeLen, sizeof(uint8_t), 1, treeFp);
-	char* type = (char*) malloc(sizeof(char)*(typeLen+1));
-	ret = fread(type, sizeof(char)*typeLen, 1, treeFp);
-	type[typeLen] = '\0';
-	thisNode->type = stringToNodeType(type);
-	free(type);
-
-	ret = fread(&(thisNode->uuidLen), sizeof(uint8_t), 1, treeFp);
-	thisNode->uuid = (char*) malloc(sizeof(char)*(thisNode->uuidLen+1));
-	ret = fread(thisNode->uuid, sizeof(char)*thisNode->uuidLen, 1, treeFp);
-	thisNode->uuid[thisNode->uuidLen] = '\0';
-
-	ret = fread(&(thisNode->descrLen), sizeof(uint16_t), 1, treeFp);
-	thisNode->description = (char*) malloc(sizeof(char)*(thisNode->descrLen+1));
-	ret = fread(thisNode->description, sizeof(char)*thisNode->descrLen, 1, treeFp);
-	thisNode->description[thisNode->descrLen] = '\0';
-
-	ret = fread(&(thisNode->datatypeLen), sizeof(uint8_t), 1, treeFp);
+/**
+ * The lengths in format version 1 are uint8, except the uint16 lengths of the description and the allowed string,
+ * and the number of children is uint8.
+ **/
+#define V1MAXLEN UINT8_MAX
+#define V1MAXLONGLEN UINT16_MAX
+
+/**
+ * Bounds-checked cursor over a format version 1 file, which is read into memory as a whole. When a field runs past the end of the file,
+ * or a string cannot be stored, status is set and the fields that follow are empty.
+ **/
+typedef struct v1Cursor_t {
+	const char* pos;
+	const char* end;
+	int status;
+} v1Cursor_t;
+
+/**
+ * Returns the len bytes at the cursor and moves past them, or NULL if the file ends before.
+ **/
+static inline const char* readBytesV1(v1Cursor_t* cursor, uint32_t len) {
+	if ((size_t)(cursor->end - cursor->pos) < len || cursor->status != VSS_OK) {
+		cursor->pos = cursor->end;
+		if (cursor->status == VSS_OK) {
+			cursor->status = VSS_ERR_TRUNCATED;
+		}
+		return NULL;
+	}
+	const char* bytes = cursor->pos;
+	cursor->pos += len;
+	return bytes;
+}
+
+uint32_t readLenV1(v1Cursor_t* cursor, size_t lenBytes) {
+	const uint8_t* len = (const uint8_t*)readBytesV1(cursor, (uint32_t)lenBytes);
+	if (len == NULL) {
+		return 0;
+	}
+	return lenBytes == sizeof(uint8_t) ? len[0] : (uint32_t)(len[0] | len[1] << 8);
+}
+
+void writeLenV1(FILE* treeFp, uint32_t len, size_t lenBytes) {
+	uint8_t len8 = (uint8_t)len;
+	uint16_t len16 = (uint16_t)len;
+	fwrite(lenBytes == sizeof(uint8_t) ? (void*)&len8 : (void*)&len16, lenBytes, 1, treeFp);
+}
+
+#define FNVOFFSETBASIS 2166136261u
+#define FNVPRIME 16777619u
+
+uint32_t hashPathBytes(uint32_t hash, const char* str, size_t len, bool foldCase) {
+	for (size_t i = 0 ; i < len ; i++) {
+		uint8_t c = foldCase == true ? (uint8_t)tolower((unsigned char)str[i]) : (uint8_t)str[i];
+		hash = (hash ^ c) * FNVPRIME;
+	}
+	return hash;
+}
+
+#define STRINGTABLEINITSIZE 1024
+
+void freeStringTable(stringTable_t* table) {
+	if (table != NULL) {
+		free(table->strings);
+		free(table->hashes);
+		free(table);
+	}
+}
+
+stringTable_t* newStringTable() {
+	stringTable_t* table = (stringTable_t*) calloc(1, sizeof(stringTable_t));
+	if (table == NULL) {
+		return NULL;
+	}
+	table->strings = (char**) calloc(STRINGTABLEINITSIZE, sizeof(char*));
+	table->hashes = (uint32_t*) malloc(sizeof(uint32_t)*STRINGTABLEINITSIZE);
+	table->mask = STRINGTABLEINITSIZE - 1;
+	if (table->strings == NULL || table->hashes == NULL) {
+		freeStringTable(table);
+		return NULL;
+	}
+	return table;
+}
+
+void insertString(stringTable_t* table, char* str, uint32_t hash) {
+	uint32_t slot = hash & table->mask;
+	while (table->strings[slot] != NULL) {
+		slot = (slot + 1) & table->mask;
+	}
+	table->strings[slot] = str;
+	table->hashes[slot] = hash;
+	table->used++;
+}
+
+bool growStringTable(stringTable_t* table) {
+	stringTable_t grown = {(char**) calloc(2*((size_t)table->mask + 1), sizeof(char*)), (uint32_t*) malloc(sizeof(uint32_t)*2*((size_t)table->mask + 1)), 2*table->mask + 1, 0};
+	if (grown.strings == NULL || grown.hashes == NULL) {
+		free(grown.strings);
+		free(grown.hashes);
+		return false;
+	}
+	for (uint32_t slot = 0 ; slot <= table->mask ; slot++) {
+		if (table->strings[slot] != NULL) {
+			insertString(&grown, table->strings[slot], table->hashes[slot]);
+		}
+	}
+	free(table->strings);
+	free(table->hashes);
+	*table = grown;
+	return true;
+}
+
+/**
+ * countAttribute() adds bytes to the accounting of the attribute class, and returns whether the class is kept.
+ **/
+static inline bool countAttribute(vssTree_t* tree, int attribute, uint64_t bytes) {
+	bool kept = (tree->attributes & attribute) != 0;
+	(kept == true ? tree->attributeBytes.kept : tree->attributeBytes.dropped)[__builtin_ctz(attribute)] += bytes;
+	return kept;
+}
+
+/**
+ * Returns the null terminated copy in the arena of the len characters of str, which is shared with the nodes that have the same string
+ * if the tree has a string table. If the table cannot grow the remaining strings are copied without sharing.
+ **/
+char* internStringV1(vssTree_t* tree, const char* str, uint32_t len) {
+	stringTable_t* table = tree->strings;
+	uint32_t hash = 0;
+	if (table != NULL) {
+		hash = hashPathBytes(FNVOFFSETBASIS, str, len, false);
+		for (uint32_t slot = hash & table->mask ; table->strings[slot] != NULL ; slot = (slot + 1) & table->mask) {
+			if (table->hashes[slot] == hash && strncmp(table->strings[slot], str, len) == 0 && table->strings[slot][len] == '\0') {
+				return table->strings[slot];
+			}
+		}
+	}
+	char* copy = (char*) arenaAlloc(tree, sizeof(char)*(len+1));
+	if (copy == NULL) {
+		return NULL;
+	}
+	memcpy(copy, str, len);
+	copy[len] = '\0';
+	tree->stats.stringPoolBytes += len + 1;
+	if (table != NULL && (2*(table->used + 1) <= table->mask + 1 || growStringTable(table) == true)) {
+		insertString(table, copy, hash);
+	}
+	return copy;
+}
+
+/**
+ * Reads a string of len characters, which is shared by internStringV1() if shared is true, else copied to the arena.
+ **/
+char* readStringV1(vssTree_t* tree, v1Cursor_t* cursor, uint32_t len, bool shared) {
+	const char* str = readBytesV1(cursor, len);
+	if (str == NULL) {
+		return NULL;
+	}
+	char* copy;
+	if (shared == true) {
+		copy = internStringV1(tree, str, len);
+	} else if ((copy = (char*) arenaAlloc(tree, sizeof(char)*(len+1))) != NULL) {
+		memcpy(copy, str, len);
+		copy[len] = '\0';
+		tree->stats.stringPoolBytes += len + 1;
+	}
+	if (copy == NULL) {
+		cursor->status = VSS_ERR_NOMEM;
+	}
+	return copy;
+}
+
+/**
+ * Reads an attribute string like readStringV1(), or skips it and returns NULL with len set to 0 if the attribute class is dropped.
+ **/
+char* readAttributeV1(vssTree_t* tree, v1Cursor_t* cursor, int attribute, uint32_t* len, bool shared) {
+	if (countAttribute(tree, attribute, *len > 0 ? *len + 1 : 0) == false) {
+		readBytesV1(cursor, *len);
+		*len = 0;
+		return NULL;
+	}
+	return readStringV1(tree, cursor, *len, shared);
+}
+
+/**
+ * Returns the length of the allowed element at index of the format version 1 allowed string "XXallowed1XXallowed2...", where XX is the hex length
+ * of the element that follows it, or -1 if the length is malformed or the element does not fit in the string.
+ **/
+int allowedElementLenV1(const char* allowedStr, uint32_t allowedLen, uint32_t index) {
+	if (allowedLen - index < 2) {
+		return -1;
+	}
+	int high = hexToInt(allowedStr[index]);
+	int low = hexToInt(allowedStr[index+1]);
+	if (high < 0 || low < 0 || (uint32_t)(high * 16 + low) > allowedLen - index - 2) {
+		return -1;
+	}
+	return high * 16 + low;
+}
+
+/**
+ * Splits the format version 1 allowed string into the allowed values of the node, which end at a malformed element.
+ * Returns VSS_ERR_NOMEM if the values could not be stored.
+ **/
+int readAllowedV1(vssTree_t* tree, node_t* node, const char* allowedStr, uint32_t allowedLen) {
+	uint32_t count = 0;
+	uint64_t bytes = 0;
+	int elemLen;
+	for (uint32_t index = 0 ; (elemLen = allowedElementLenV1(allowedStr, allowedLen, index)) >= 0 ; index += elemLen + 2) {
+		count++;
+		bytes += sizeof(vssAllowed_t) + (elemLen > 0 ? elemLen + 1 : 0);
+	}
+	node->allowed = 0;
+	node->allowedDef = NULL;
+	if (countAttribute(tree, VSS_ATTR_ALLOWED, bytes) == false || count == 0) {
+		return VSS_OK;
+	}
+	node->allowedDef = (vssAllowed_t*) arenaAlloc(tree, sizeof(vssAllowed_t)*count);
+	if (node->allowedDef == NULL) {
+		return VSS_ERR_NOMEM;
+	}
+	for (uint32_t index = 0 ; node->allowed < count ; index += elemLen + 2) {
+		elemLen = allowedElementLenV1(allowedStr, allowedLen, index);
+		char* value = internStringV1(tree, &allowedStr[index+2], (uint32_t)elemLen);
+		if (value == NULL) {
+			return VSS_ERR_NOMEM;
+		}
+		node->allowedDef[node->allowed].value = value;
+		node->allowedDef[node->allowed++].len = (uint32_t)elemLen;
+	}
+	return VSS_OK;
+}
+
+/**
+ * Copies a field of at most UINT8_MAX characters to the null terminated str, which the string to code conversions take.
+ **/
+static void readFieldV1(v1Cursor_t* cursor, char* str) {
+	uint32_t len = readLenV1(cursor, sizeof(uint8_t));
+	const char* field = readBytesV1(cursor, len);
+	if (field == NULL) {
+		len = 0;
+	}
+	memcpy(str, field != NULL ? field : "", len);
+	str[len] = '\0';
+}
+
+/**
+ * Decodes the node at the cursor, and returns the cursor status, which is not VSS_OK if the node is truncated or a string could not be stored.
+ **/
+int populateNode(vssTree_t* tree, v1Cursor_t* cursor, node_t* thisNode) {
+	thisNode->nameLen = readLenV1(cursor, sizeof(uint8_t));
+	thisNode->name = readStringV1(tree, cursor, thisNode->nameLen, true);
+
+	char field[UINT8_MAX+1];
+	readFieldV1(cursor, field);
+	thisNode->type = stringToNodeType(field);
+	if (thisNode->type == UNKNOWN && tree->quiet == false) {
+		printf("Unknown type! |%s|\n", field);
+	}
+
+	thisNode->uuidLen = readLenV1(cursor, sizeof(uint8_t));
+	thisNode->uuid = readAttributeV1(tree, cursor, VSS_ATTR_UUID, &thisNode->uuidLen, false);  // unique per node
+
+	thisNode->descrLen = readLenV1(cursor, sizeof(uint16_t));
+	thisNode->description = readAttributeV1(tree, cursor, VSS_ATTR_DESCR, &thisNode->descrLen, true);
+
+	thisNode->datatypeLen = readLenV1(cursor, sizeof(uint8_t));
 	if (thisNode->datatypeLen > 0) {
-		thisNode->datatype = (char*) malloc(sizeof(char)*(thisNode->datatypeLen+1));
-		ret = fread(thisNode->datatype, sizeof(char)*thisNode->datatypeLen, 1, treeFp);
-		thisNode->datatype[thisNode->datatypeLen] = '\0';
+		thisNode->datatype = readStringV1(tree, cursor, thisNode->datatypeLen, true);
+		thisNode->datatypeLen = thisNode->datatype != NULL ? thisNode->datatypeLen : 0;
 	}
+	thisNode->datatypeCode = datatypeToCode(thisNode->datatype, thisNode->datatypeLen);
 
-	ret = fread(&(thisNode->minLen), sizeof(uint8_t), 1, treeFp);
+	thisNode->minLen = readLenV1(cursor, sizeof(uint8_t));
 	if (thisNode->minLen > 0) {
-		thisNode->min = (char*) malloc(sizeof(char)*(thisNode->minLen+1));
-		ret = fread(thisNode->min, sizeof(char)*thisNode->minLen, 1, treeFp);
-		thisNode->min[thisNode->minLen] = '\0';
+		thisNode->min = readAttributeV1(tree, cursor, VSS_ATTR_RANGE, &thisNode->minLen, true);
 	}
 
-	ret = fread(&(thisNode->maxLen), sizeof(uint8_t), 1, treeFp);
+	thisNode->maxLen = readLenV1(cursor, sizeof(uint8_t));
 	if (thisNode->maxLen > 0) {
-		thisNode->max = (char*) malloc(sizeof(char)*(thisNode->maxLen+1));
-		ret = fread(thisNode->max, sizeof(char)*thisNode->maxLen, 1, treeFp);
-		thisNode->max[thisNode->maxLen] = '\0';
+		thisNode->max = readAttributeV1(tree, cursor, VSS_ATTR_RANGE, &thisNode->maxLen, true);
 	}
 
-	ret = fread(&(thisNode->unitLen), sizeof(uint8_t), 1, treeFp);
+	thisNode->unitLen = readLenV1(cursor, sizeof(uint8_t));
 	if (thisNode->unitLen > 0) {
-		thisNode->unit = (char*) malloc(sizeof(char)*(thisNode->unitLen+1));
-		ret = fread(thisNode->unit, sizeof(char)*thisNode->unitLen, 1, treeFp);
-		thisNode->unit[thisNode->unitLen] = '\0';
-	}
-
-	uint16_t allowedLen;
-	ret = fread(&allowedLen, sizeof(uint16_t), 1, treeFp);
-	if (allowedLen > 0) {
-		char* allowedStr = (char*) malloc(sizeof(char)*(allowedLen+1));
-		ret = fread(allowedStr, sizeof(char)*allowedLen, 1, treeFp);
-		allowedStr[allowedLen] = '\0';
- 	        thisNode->allowed = (uint8_t)countAllowedElements(allowedStr);
-	        if (thisNode->allowed > 0) {
-		        thisNode->allowedDef = (allowed_t*) malloc(sizeof(allowed_t)*(thisNode->allowed));
-                }
-	        for (int i = 0 ; i < thisNode->allowed ; i++) {
-	            strcpy(thisNode->allowedDef[i], extractAllowedElement(allowedStr, i));
-	        }
-	} else {
-	    thisNode->allowed = 0;
+		thisNode->unit = readAttributeV1(tree, cursor, VSS_ATTR_UNIT, &thisNode->unitLen, true);
 	}
 
-	ret = fread(&(thisNode->defaultLen), sizeof(uint8_t), 1, treeFp);
-	if (thisNode->defaultLen > 0) {
-		thisNode->defaultAllowed = (char*) malloc(sizeof(char)*(thisNode->defaultLen+1));
-		ret = fread(thisNode->defaultAllowed, sizeof(char)*thisNode->defaultLen, 1, treeFp);
-		thisNode->defaultAllowed[thisNode->defaultLen] = '\0';
+	uint32_t allowedLen = readLenV1(cursor, sizeof(uint16_t));
+	const char* allowedStr = readBytesV1(cursor, allowedLen);
+	thisNode->allowed = 0;
+	if (allowedLen > 0 && allowedStr != NULL && cursor->status == VSS_OK) {
+		cursor->status = readAllowedV1(tree, thisNode, allowedStr, allowedLen);
+	}
+	if (cursor->status == VSS_OK) {
+		cursor->status = sortAllowed(tree, thisNode);
 	}
 
-	uint8_t validateLen;
-	ret = fread(&validateLen, sizeof(uint8_t), 1, treeFp);
-	if (validateLen > 0) {
-		char validate[50];
-		ret = fread(validate, sizeof(char)*validateLen, 1, treeFp);
-		validate[validateLen] = '\0';
-		thisNode->validate = validateToUint8(validate);
-	} else {
-	    thisNode->validate = 0;
+	thisNode->defaultLen = readLenV1(cursor, sizeof(uint8_t));
+	if (thisNode->defaultLen > 0) {
+		thisNode->defaultAllowed = readAttributeV1(tree, cursor, VSS_ATTR_RANGE, &thisNode->defaultLen, true);
 	}
 
-	ret = fread(&(thisNode->children), sizeof(uint8_t), 1, treeFp);
+	readFieldV1(cursor, field);
+	thisNode->validate = field[0] != '\0' ? validateToUint8(field) : 0;
+
+	thisNode->children = readLenV1(cursor, sizeof(uint8_t));
+	if (cursor->status != VSS_OK) {
+		thisNode->children = 0;
+		return cursor->status;
+	}
 
 //	printf("populateNode: %s\n", thisNode->name);
+	return parseRange(tree, thisNode);
 }
 
-int calculatAllowedStrLen(uint8_t alloweds, allowed_t* allowedDef) {
+int calculatAllowedStrLen(uint32_t alloweds, vssAllowed_t* allowedDef) {
     int strLen = 0;
-    for (int i = 0 ; i < alloweds ; i++) {
-        strLen += strlen((char*)(allowedDef[i])) + 2;
+    for (uint32_t i = 0 ; i < alloweds ; i++) {
+        strLen += allowedDef[i].len + 2;
     }
     return strLen;
 }
 
-void allowedWrite(char* theAllowed) {
-    fwrite(intToHex(strlen(theAllowed)), 2, 1, treeFp);
-    fwrite(theAllowed, sizeof(char)*strlen(theAllowed), 1, treeFp);
+void allowedWrite(FILE* treeFp, vssAllowed_t* theAllowed) {
+    char hexVal[3];
+    fwrite(intToHex(theAllowed->len, hexVal), 2, 1, treeFp);
+    fwrite(theAllowed->value, sizeof(char)*theAllowed->len, 1, treeFp);
 }
 
-void writeNode(struct node_t* node) {
-	fwrite(&(node->nameLen), sizeof(uint8_t), 1, treeFp);
+void writeNode(FILE* treeFp, struct node_t* node) {
+	writeLenV1(treeFp, node->nameLen, sizeof(uint8_t));
 	fwrite(node->name, sizeof(char)*node->nameLen, 1, treeFp);
 
         char nodeType[50];
@@ -466,28 +1070,32 @@ void writeNode(struct node_t* node) {
 	    fwrite(nodeType, sizeof(char)*nodeTypeLen, 1, treeFp);
 	}
 
-	fwrite(&(node->uuidLen), sizeof(uint8_t), 1, treeFp);
-	fwrite(node->uuid, sizeof(char)*node->uuidLen, 1, treeFp);
+	writeLenV1(treeFp, node->uuidLen, sizeof(uint8_t));
+	if (node->uuidLen > 0) {
+		fwrite(node->uuid, sizeof(char)*node->uuidLen, 1, treeFp);
+	}
 
-	fwrite(&(node->descrLen), sizeof(uint16_t), 1, treeFp);
-	fwrite(node->description, sizeof(char)*node->descrLen, 1, treeFp);
+	writeLenV1(treeFp, node->descrLen, sizeof(uint16_t));
+	if (node->descrLen > 0) {
+		fwrite(node->description, sizeof(char)*node->descrLen, 1, treeFp);
+	}
 
-	fwrite(&(node->datatypeLen), sizeof(uint8_t), 1, treeFp);
+	writeLenV1(treeFp, node->datatypeLen, sizeof(uint8_t));
         if (node->datatypeLen > 0) {
 	    fwrite(node->datatype, sizeof(char)*node->datatypeLen, 1, treeFp);
 	}
 
-	fwrite(&(node->minLen), sizeof(uint8_t), 1, treeFp);
+	writeLenV1(treeFp, node->minLen, sizeof(uint8_t));
 	if (node->minLen > 0) {
 		fwrite(node->min, sizeof(char)*node->minLen, 1, treeFp);
 	}
 
-	fwrite(&(node->maxLen), sizeof(uint8_t), 1, treeFp);
+	writeLenV1(treeFp, node->maxLen, sizeof(uint8_t));
 	if (node->maxLen > 0) {
 		fwrite(node->max, sizeof(char)*node->maxLen, 1, treeFp);
 	}
 
-	fwrite(&(node->unitLen), sizeof(uint8_t), 1, treeFp);
+	writeLenV1(treeFp, node->unitLen, sizeof(uint8_t));
 	if (node->unitLen > 0) {
 		fwrite(node->unit, sizeof(char)*node->unitLen, 1, treeFp);
 	}
@@ -495,15 +1103,15 @@ void writeNode(struct node_t* node) {
         int allowedStrLen = 0;
         if (node->allowed > 0) {
             allowedStrLen = calculatAllowedStrLen(node->allowed, node->allowedDef);
-            fwrite(&allowedStrLen, sizeof(uint16_t), 1, treeFp);
-	    for (int i = 0 ; i < node->allowed ; i++) {
-	        allowedWrite((char*)(node->allowedDef[i]));
+            writeLenV1(treeFp, allowedStrLen, sizeof(uint16_t));
+	    for (uint32_t i = 0 ; i < node->allowed ; i++) {
+	        allowedWrite(treeFp, &node->allowedDef[i]);
 	    }
         } else {
-            fwrite(&allowedStrLen, sizeof(uint16_t), 1, treeFp);
+            writeLenV1(treeFp, allowedStrLen, sizeof(uint16_t));
         }
 
-	fwrite(&(node->defaultLen), sizeof(uint8_t), 1, treeFp);
+	writeLenV1(treeFp, node->defaultLen, sizeof(uint8_t));
 	if (node->defaultLen > 0) {
 		fwrite(node->defaultAllowed, sizeof(char)*node->defaultLen, 1, treeFp);
 	}
@@ -511,185 +1119,2304 @@ void writeNode(struct node_t* node) {
 	char validate[10+1+7+1];  // access control + consent data
 	validateToString(node->validate, (char*)&validate);
 	int validateLen = strlen(validate);
-	fwrite(&validateLen, sizeof(uint8_t), 1, treeFp);
+	writeLenV1(treeFp, validateLen, sizeof(uint8_t));
 	if (validateLen > 0) {
 	    fwrite(validate, sizeof(char)*validateLen, 1, treeFp);
 	}
 
-	fwrite(&(node->children), sizeof(uint8_t), 1, treeFp);
+	writeLenV1(treeFp, node->children, sizeof(uint8_t));
 
 //        printf("writeNode: %s\n", node->name);
 }
 
-struct node_t* traverseAndReadNode(struct node_t* parentNode) {
-	node_t* thisNode = (node_t*) malloc(sizeof(node_t));
-	updateReadMetadata(true);
-	populateNode(thisNode);
+/**
+ * The inherited validation of a node is computed from that of its parent, so the parent must be loaded first, which pre-order guarantees.
+ **/
+void inheritValidation(node_t* node) {
+	node->inheritedValidate = getMaxValidation(node->validate, node->parent != NULL ? node->parent->inheritedValidate : 0);
+}
 
-	thisNode->parent = parentNode;
+/**
+ * Growable stack of the ancestors of the node in focus in a walk of the tree, with the number of children of each that have been visited.
+ * It starts in the buffers inside it, so a walk of a tree that is not deeper than NODESTACKBUFLEN does not allocate.
+ **/
+typedef struct nodeStack_t {
+	node_t** nodes;
+	uint32_t* visited;
+	uint32_t depth;
+	uint32_t size;
+	bool outOfMemory;
+	node_t* nodesBuf[NODESTACKBUFLEN];
+	uint32_t visitedBuf[NODESTACKBUFLEN];
+} nodeStack_t;
+
+void initNodeStack(nodeStack_t* stack) {
+	stack->nodes = stack->nodesBuf;
+	stack->visited = stack->visitedBuf;
+	stack->depth = 0;
+	stack->size = NODESTACKBUFLEN;
+	stack->outOfMemory = false;
+}
 
-	if (thisNode->children > 0)
-		thisNode->child = (node_t**) malloc(sizeof(node_t**)*thisNode->children);
-	for (int childNo = 0 ; childNo < thisNode->children ; childNo++) {
-		thisNode->child[childNo] = traverseAndReadNode(thisNode);
+void freeNodeStack(nodeStack_t* stack) {
+	if (stack->nodes != stack->nodesBuf) {
+		free(stack->nodes);
+		free(stack->visited);
 	}
-	updateReadMetadata(false);
-	return thisNode;
 }
 
-void traverseAndWriteNode(struct node_t* node) {
-	writeNode(node);
-	for (int childNo = 0 ; childNo < node->children ; childNo++) {
-		traverseAndWriteNode(node->child[childNo]);
+bool pushNode(nodeStack_t* stack, node_t* node) {
+	if (stack->depth == stack->size) {
+		node_t** nodes = (node_t**) malloc(sizeof(node_t*)*2*stack->size);
+		uint32_t* visited = (uint32_t*) malloc(sizeof(uint32_t)*2*stack->size);
+		if (nodes == NULL || visited == NULL) {
+			free(nodes);
+			free(visited);
+			stack->outOfMemory = true;
+			return false;
+		}
+		memcpy(nodes, stack->nodes, sizeof(node_t*)*stack->depth);
+		memcpy(visited, stack->visited, sizeof(uint32_t)*stack->depth);
+		freeNodeStack(stack);
+		stack->nodes = nodes;
+		stack->visited = visited;
+		stack->size *= 2;
+	}
+	stack->nodes[stack->depth] = node;
+	stack->visited[stack->depth++] = 0;
+	return true;
+}
+
+/**
+ * startWalk() and nextNode() return the nodes of the subtree of root in pre-order, and NULL after the last one or if the stack cannot grow.
+ **/
+node_t* startWalk(nodeStack_t* stack, node_t* root) {
+	initNodeStack(stack);
+	if (root->children > 0 && pushNode(stack, root) == false) {
+		return NULL;
+	}
+	return root;
+}
+
+node_t* nextNode(nodeStack_t* stack) {
+	while (stack->depth > 0) {
+		node_t* parent = stack->nodes[stack->depth-1];
+		if (stack->visited[stack->depth-1] < parent->children) {
+			node_t* node = parent->child[stack->visited[stack->depth-1]++];
+			if (node->children > 0 && pushNode(stack, node) == false) {
+				return NULL;
+			}
+			return node;
+		}
+		stack->depth--;
+	}
+	return NULL;
+}
+
+/**
+ * readTreeV1() reads a format version 1 file into memory as a whole, and decodes its nodes from there. The nodes are in pre-order,
+ * so the parent of a node is the node on top of the stack. A node is popped, and its children are sorted, when all its children have been read.
+ * A file that ends within the tree is truncated, and a file with bytes after the tree is corrupt.
+ **/
+node_t* readTreeV1(vssTree_t* tree, FILE* treeFp, int* status) {
+	long fileSize = fseek(treeFp, 0, SEEK_END) == 0 ? ftell(treeFp) : -1;
+	if (fileSize <= 0 || fseek(treeFp, 0, SEEK_SET) != 0) {
+		*status = fileSize == 0 ? VSS_ERR_TRUNCATED : VSS_ERR_OPEN;
+		return NULL;
+	}
+	char* fileBuf = (char*) malloc((size_t)fileSize);
+	if (fileBuf == NULL) {
+		*status = VSS_ERR_NOMEM;
+		return NULL;
+	}
+	if (fread(fileBuf, 1, (size_t)fileSize, treeFp) != (size_t)fileSize) {
+		free(fileBuf);
+		*status = VSS_ERR_TRUNCATED;
+		return NULL;
+	}
+	tree->stats.bytesRead = (uint64_t)fileSize;
+	v1Cursor_t cursor = {fileBuf, fileBuf + fileSize, VSS_OK};
+	nodeStack_t stack;
+	node_t* root = NULL;
+	initNodeStack(&stack);
+	do {
+		node_t* thisNode = (node_t*) arenaCalloc(tree, sizeof(node_t));  // zeroed, as the optional fields are only set if present
+		if (thisNode == NULL) {
+			*status = VSS_ERR_NOMEM;
+			break;
+		}
+		updateReadMetadata(tree, true);
+		*status = populateNode(tree, &cursor, thisNode);
+		if (*status != VSS_OK) {
+			break;
+		}
+		countNodeType(tree, thisNode);
+
+		thisNode->parent = stack.depth > 0 ? stack.nodes[stack.depth-1] : NULL;
+		inheritValidation(thisNode);
+		thisNode->tree = tree;
+		thisNode->index = (uint32_t)tree->readTreeMetadata.totalNodes - 1;
+		if (thisNode->parent != NULL) {
+			thisNode->parent->child[stack.visited[stack.depth-1]++] = thisNode;
+		} else {
+			root = thisNode;
+		}
+
+		if (thisNode->children > 0) {
+			thisNode->child = (node_t**) arenaAlloc(tree, sizeof(node_t**)*thisNode->children);
+			if (thisNode->child == NULL || pushNode(&stack, thisNode) == false) {
+				*status = VSS_ERR_NOMEM;
+				break;
+			}
+		} else {
+			updateReadMetadata(tree, false);
+		}
+		while (stack.depth > 0 && stack.visited[stack.depth-1] == stack.nodes[stack.depth-1]->children) {
+			sortChildren(tree, stack.nodes[--stack.depth]);
+			updateReadMetadata(tree, false);
+		}
+	} while (stack.depth > 0);
+	if (*status == VSS_OK && cursor.pos != cursor.end) {
+		*status = VSS_ERR_CORRUPT;
+	}
+	freeNodeStack(&stack);
+	free(fileBuf);
+	return root;
+}
+
+/**
+ * Format version 1 cannot hold longer fields or more children, which format version 2 has no limit on.
+ **/
+bool nodeFitsFormatV1(node_t* node) {
+	if (node->nameLen > V1MAXLEN || node->uuidLen > V1MAXLEN || node->descrLen > V1MAXLONGLEN || node->datatypeLen > V1MAXLEN ||
+	    node->minLen > V1MAXLEN || node->maxLen > V1MAXLEN || node->unitLen > V1MAXLEN || node->defaultLen > V1MAXLEN ||
+	    node->children > V1MAXLEN || calculatAllowedStrLen(node->allowed, node->allowedDef) > V1MAXLONGLEN) {
+		printf("Node %s exceeds the field limits of format version 1\n", node->name);
+		return false;
+	}
+	for (uint32_t i = 0 ; i < node->allowed ; i++) {
+		if (node->allowedDef[i].len > V1MAXLEN) {  // the element length is two hex digits
+			printf("Node %s exceeds the field limits of format version 1\n", node->name);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool fitsFormatV1(node_t* root) {
+	nodeStack_t stack;
+	bool fits = true;
+	for (node_t* node = startWalk(&stack, root) ; node != NULL && fits == true ; node = nextNode(&stack)) {
+		fits = nodeFitsFormatV1(node);
+	}
+	freeNodeStack(&stack);
+	return fits == true && stack.outOfMemory == false;
+}
+
+bool traverseAndWriteNode(FILE* treeFp, struct node_t* root) {
+	nodeStack_t stack;
+	for (node_t* node = startWalk(&stack, root) ; node != NULL ; node = nextNode(&stack)) {
+		writeNode(treeFp, node);
+	}
+	freeNodeStack(&stack);
+	return stack.outOfMemory == false;
+}
+
+uint16_t getUint16(const uint8_t* buf) {
+	return (uint16_t)(buf[0] | buf[1] << 8);
+}
+
+uint32_t getUint32(const uint8_t* buf) {
+	return (uint32_t)buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+/**
+ * readFileInfo() reads the format version 2 header, or rewinds the file if it has the original format without header.
+ * Incompatible or truncated files are rejected before any node is parsed.
+ **/
+int readFileInfo(FILE* fp, vssFileInfo_t* info) {
+	uint8_t header[V2HEADERSIZE];
+	memset(info, 0, sizeof(vssFileInfo_t));
+	size_t headerLen = fread(header, 1, V2HEADERSIZE, fp);
+	if (headerLen < 4 || memcmp(header, V2MAGIC, 4) != 0) {
+		info->version = 1;
+		rewind(fp);
+		return headerLen == 0 ? VSS_ERR_TRUNCATED : VSS_OK;
+	}
+	if (headerLen < V2HEADERSIZE) {
+		return VSS_ERR_TRUNCATED;
+	}
+	info->version = header[4];
+	info->endianness = header[5];
+	if (info->version != 2) {
+		return VSS_ERR_VERSION;
+	}
+	if (info->endianness != V2LITTLEENDIAN) {
+		return VSS_ERR_ENDIANNESS;
+	}
+	if (getUint16(&header[6]) != V2HEADERSIZE) {
+		return VSS_ERR_FORMAT;
+	}
+	info->nodeCount = getUint32(&header[8]);
+	info->maxDepth = getUint32(&header[12]);
+	info->stringPoolSize = getUint32(&header[16]);
+	info->nodeSectionSize = getUint32(&header[20]);
+	info->descrPoolOffset = getUint32(&header[24]);
+	if (info->nodeCount == 0 || info->maxDepth == 0 || info->maxDepth > info->nodeCount || info->descrPoolOffset >= info->stringPoolSize) {
+		return VSS_ERR_CORRUPT;
+	}
+	long expectedSize = V2HEADERSIZE + sizeof(uint32_t)*(long)info->nodeCount + info->nodeSectionSize + info->stringPoolSize;
+	if (fseek(fp, 0, SEEK_END) != 0 || ftell(fp) < expectedSize || fseek(fp, V2HEADERSIZE, SEEK_SET) != 0) {
+		return VSS_ERR_TRUNCATED;
+	}
+	return VSS_OK;
+}
+
+/**
+ * decodeVarint() decodes an unsigned LEB128 value of at most 32 bits, which has 7 bits per byte, least significant first,
+ * and the high bit set in all but the last byte. Lengths and counts mostly take one byte, and string offsets a few, so away from the end
+ * of the record the bytes are tested one by one without bounds checks, which the branch predictor follows better than a branch-free decode
+ * of a 64-bit load, whose computed length delays the decoding of the next value. The decoders of the node fields are inlined into
+ * decodeNodeV2(), as they are the bulk of the load time.
+ **/
+static inline __attribute__((always_inline)) int decodeVarint(const uint8_t** cursor, const uint8_t* recEnd, uint32_t* value) {
+	const uint8_t* pos = *cursor;
+	if (pos < recEnd && pos[0] < 0x80) {
+		*value = pos[0];
+		*cursor = pos + 1;
+		return VSS_OK;
+	}
+	if (recEnd - pos >= V2MAXVARINTLEN) {
+		uint32_t result = (pos[0] & 0x7F) | (uint32_t)pos[1] << 7;
+		if (pos[1] < 0x80) {
+			*value = result;
+			*cursor = pos + 2;
+			return VSS_OK;
+		}
+		result = (result & 0x3FFF) | (uint32_t)pos[2] << 14;
+		if (pos[2] < 0x80) {
+			*value = result;
+			*cursor = pos + 3;
+			return VSS_OK;
+		}
+		result = (result & 0x1FFFFF) | (uint32_t)pos[3] << 21;
+		if (pos[3] < 0x80) {
+			*value = result;
+			*cursor = pos + 4;
+			return VSS_OK;
+		}
+		if (pos[4] > 0x0F) {  // more than 32 bits
+			return VSS_ERR_CORRUPT;
+		}
+		*value = (result & 0xFFFFFFF) | (uint32_t)pos[4] << 28;
+		*cursor = pos + 5;
+		return VSS_OK;
+	}
+	uint32_t result = 0;
+	for (int shift = 0 ; shift < 7*V2MAXVARINTLEN && pos < recEnd ; shift += 7) {
+		uint8_t byte = *pos++;
+		result |= (uint32_t)(byte & 0x7F) << shift;
+		if (byte < 0x80) {
+			if (shift == 28 && byte > 0x0F) {
+				break;
+			}
+			*value = result;
+			*cursor = pos;
+			return VSS_OK;
+		}
+	}
+	return VSS_ERR_CORRUPT;
+}
+
+int VSSDecodeVarint(const uint8_t** cursor, const uint8_t* end, uint32_t* value) {
+	return decodeVarint(cursor, end, value);
+}
+
+/**
+ * A string reference is the varint offset of a null terminated string in the string pool, relative to base, followed by its varint length.
+ **/
+static inline __attribute__((always_inline)) int decodeString(const uint8_t** cursor, const uint8_t* recEnd, stringPool_t* pool, uint32_t base, char** str, uint32_t* len, uint32_t maxLen) {
+	uint32_t offset;
+	if (decodeVarint(cursor, recEnd, &offset) != VSS_OK || decodeVarint(cursor, recEnd, len) != VSS_OK) {
+		return VSS_ERR_CORRUPT;
+	}
+	if (offset >= pool->size - base || *len >= pool->size - base - offset || (pool->verify == true && pool->buf[base + offset + *len] != '\0')) {
+		return VSS_ERR_CORRUPT;
+	}
+	*str = &pool->buf[base + offset];
+	return *len > maxLen ? VSS_ERR_LIMIT : VSS_OK;
+}
+
+/**
+ * Decodes the string reference of an attribute like decodeString(), or skips it and returns NULL with len set to 0 if the attribute class is dropped.
+ * A skipped reference is not checked against the pool, which does not hold the descriptions if they are dropped.
+ **/
+static inline __attribute__((always_inline)) int decodeAttribute(vssTree_t* tree, int attribute, const uint8_t** cursor, const uint8_t* recEnd, stringPool_t* pool, uint32_t base, char** str, uint32_t* len) {
+	uint32_t offset;
+	if ((tree->attributes & attribute) != 0) {
+		int status = decodeString(cursor, recEnd, pool, base, str, len, UINT32_MAX);
+		countAttribute(tree, attribute, status == VSS_OK && *len > 0 ? *len + 1 : 0);
+		return status;
+	}
+	if (decodeVarint(cursor, recEnd, &offset) != VSS_OK || decodeVarint(cursor, recEnd, len) != VSS_OK) {
+		return VSS_ERR_CORRUPT;
+	}
+	countAttribute(tree, attribute, *len > 0 ? (uint64_t)*len + 1 : 0);
+	*str = NULL;
+	*len = 0;
+	return VSS_OK;
+}
+
+/**
+ * A code is one byte, with values up to maxCode.
+ **/
+static inline __attribute__((always_inline)) int decodeCode(const uint8_t** cursor, const uint8_t* recEnd, uint8_t maxCode, uint8_t* code) {
+	if (*cursor >= recEnd || **cursor > maxCode) {
+		return VSS_ERR_CORRUPT;
+	}
+	*code = *(*cursor)++;
+	return VSS_OK;
+}
+
+/**
+ * Empty optional fields are NULL, as in a tree read from format version 1.
+ **/
+char* optionalString(char* str, uint32_t len) {
+	return len > 0 ? str : NULL;
+}
+
+/**
+ * decodeStructureV2() decodes the fields at the start of a format version 2 record, which are those needed for the tree structure and searches.
+ * The strings are not copied, they point into the string pool.
+ **/
+static inline __attribute__((always_inline)) int decodeStructureV2(node_t* node, const uint8_t** cursor, const uint8_t* recEnd, stringPool_t* pool) {
+	uint8_t code;
+	int status;
+	if ((status = decodeString(cursor, recEnd, pool, 0, &node->name, &node->nameLen, UINT32_MAX)) != VSS_OK) return status;
+	if ((status = decodeCode(cursor, recEnd, PROPERTY, &code)) != VSS_OK) return status;
+	node->type = (nodeTypes_t)code;
+	if ((status = decodeCode(cursor, recEnd, UINT8_MAX, &node->datatypeCode)) != VSS_OK) return status;
+	if ((node->datatypeCode & ~VSS_DATATYPE_ARRAY) > VSS_DATATYPE_STRUCT) return VSS_ERR_CORRUPT;
+	if ((status = decodeString(cursor, recEnd, pool, 0, &node->datatype, &node->datatypeLen, UINT32_MAX)) != VSS_OK) return status;
+	node->datatype = optionalString(node->datatype, node->datatypeLen);
+	if ((status = decodeCode(cursor, recEnd, VSS_VALIDATE_CONSENT + VSS_VALIDATE_READ_WRITE, &node->validate)) != VSS_OK) return status;
+	if (node->validate % VSS_VALIDATE_CONSENT > VSS_VALIDATE_READ_WRITE) return VSS_ERR_CORRUPT;
+	return decodeVarint(cursor, recEnd, &node->children);
+}
+
+/**
+ * decodeAttributesV2() decodes the remaining fields of the record, from the cursor that decodeStructureV2() left.
+ **/
+int decodeAttributesV2(vssTree_t* tree, node_t* node, const uint8_t* cursor, const uint8_t* recEnd, stringPool_t* pool) {
+	int status;
+	if ((status = decodeAttribute(tree, VSS_ATTR_UUID, &cursor, recEnd, pool, 0, &node->uuid, &node->uuidLen)) != VSS_OK) return status;
+	if ((status = decodeAttribute(tree, VSS_ATTR_DESCR, &cursor, recEnd, pool, pool->descrBase, &node->description, &node->descrLen)) != VSS_OK) return status;
+	if ((status = decodeAttribute(tree, VSS_ATTR_RANGE, &cursor, recEnd, pool, 0, &node->min, &node->minLen)) != VSS_OK) return status;
+	node->min = optionalString(node->min, node->minLen);
+	if ((status = decodeAttribute(tree, VSS_ATTR_RANGE, &cursor, recEnd, pool, 0, &node->max, &node->maxLen)) != VSS_OK) return status;
+	node->max = optionalString(node->max, node->maxLen);
+	if ((status = decodeAttribute(tree, VSS_ATTR_UNIT, &cursor, recEnd, pool, 0, &node->unit, &node->unitLen)) != VSS_OK) return status;
+	node->unit = optionalString(node->unit, node->unitLen);
+
+	if ((status = decodeVarint(&cursor, recEnd, &node->allowed)) != VSS_OK) return status;
+	node->allowedDef = NULL;
+	if (node->allowed > (uint32_t)(recEnd - cursor) / 2) {  // every element reference takes at least two bytes
+		return VSS_ERR_CORRUPT;
+	}
+	bool keepAllowed = countAttribute(tree, VSS_ATTR_ALLOWED, sizeof(vssAllowed_t)*(uint64_t)node->allowed);
+	if (keepAllowed == true && node->allowed > 0) {
+		node->allowedDef = (vssAllowed_t*) arenaAlloc(tree, sizeof(vssAllowed_t)*node->allowed);
+		if (node->allowedDef == NULL) {
+			return VSS_ERR_NOMEM;
+		}
+	}
+	for (uint32_t i = 0 ; i < node->allowed ; i++) {
+		vssAllowed_t skipped;
+		vssAllowed_t* element = keepAllowed == true ? &node->allowedDef[i] : &skipped;
+		if ((status = decodeAttribute(tree, VSS_ATTR_ALLOWED, &cursor, recEnd, pool, 0, &element->value, &element->len)) != VSS_OK) return status;
+	}
+	if (keepAllowed == false) {
+		node->allowed = 0;
+	}
+	if ((status = sortAllowed(tree, node)) != VSS_OK) return status;
+
+	if ((status = decodeAttribute(tree, VSS_ATTR_RANGE, &cursor, recEnd, pool, 0, &node->defaultAllowed, &node->defaultLen)) != VSS_OK) return status;
+	node->defaultAllowed = optionalString(node->defaultAllowed, node->defaultLen);
+	node->range = NULL;
+	return parseRange(tree, node);
+}
+
+/**
+ * decodeNodeV2() populates the node from its format version 2 record. In a VSS_LOAD_LAZY tree only the structure is decoded,
+ * and the position of the attributes is kept for decodeLazyAttributes().
+ **/
+int decodeNodeV2(vssTree_t* tree, node_t* node, const uint8_t* rec, const uint8_t* recEnd, stringPool_t* pool) {
+	const uint8_t* cursor = rec;
+	int status = decodeStructureV2(node, &cursor, recEnd, pool);
+	if (status != VSS_OK) {
+		return status;
+	}
+	if (tree->lazyRecords != NULL) {
+		node->lazyAttributes = (uint32_t)(cursor - tree->lazyRecords);  // not 0, as the structure comes first in a record
+		return VSS_OK;
+	}
+	return decodeAttributesV2(tree, node, cursor, recEnd, pool);
+}
+
+/**
+ * Decodes the attributes of a node of a VSS_LOAD_LAZY tree, unless another thread did so first. The lock serializes the decoding,
+ * which allocates from the arena of the tree, so a getter waits at most for the decoding of one record by another thread.
+ * If the record turns out to be corrupt the attributes it did not give are left empty.
+ **/
+void decodeLazyAttributes(node_t* node) {
+	vssTree_t* tree = node->tree;
+	pthread_mutex_lock(&tree->lazyLock);
+	if (node->lazyAttributes != 0) {
+		if (decodeAttributesV2(tree, node, tree->lazyRecords + node->lazyAttributes, tree->lazyRecords + tree->lazyRecordsLen, &tree->lazyPool) != VSS_OK) {
+			node->allowed = 0;
+			node->allowedSorted = NULL;
+			node->range = NULL;
+		}
+		__atomic_store_n(&node->lazyAttributes, 0, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&tree->lazyLock);
+}
+
+/**
+ * Returns the node with its attributes decoded, which the getters of the attributes call.
+ **/
+static inline node_t* withAttributes(long nodeHandle) {
+	node_t* node = (node_t*)((intptr_t)nodeHandle);
+	if (__atomic_load_n(&node->lazyAttributes, __ATOMIC_ACQUIRE) != 0) {
+		decodeLazyAttributes(node);
+	}
+	return node;
+}
+
+/**
+ * linkNodesV2() sets the parent and child pointers of the nodes, which are stored in pre-order.
+ **/
+int linkNodesV2(vssTree_t* tree, node_t* nodes, node_t** childPtrs, vssFileInfo_t* info) {
+	node_t** stack = (node_t**) malloc(sizeof(node_t*)*info->maxDepth);
+	uint32_t* fill = (uint32_t*) malloc(sizeof(uint32_t)*info->maxDepth);
+	if (stack == NULL || fill == NULL) {
+		free(stack);
+		free(fill);
+		return VSS_ERR_NOMEM;
+	}
+	int status = VSS_OK;
+	uint32_t depth = 0;
+	uint32_t usedChildPtrs = 0;
+	for (uint32_t i = 0 ; i < info->nodeCount && status == VSS_OK ; i++) {
+		node_t* node = &nodes[i];
+		node->parent = NULL;
+		node->child = NULL;
+		if (i > 0) {
+			if (depth == 0) {  // more than one root
+				status = VSS_ERR_CORRUPT;
+				break;
+			}
+			node->parent = stack[depth-1];
+			node->parent->child[fill[depth-1]++] = node;
+		}
+		inheritValidation(node);
+		countNodeType(tree, node);
+		if (depth + 1 > (uint32_t)tree->readTreeMetadata.maxTreeDepth) {
+			tree->readTreeMetadata.maxTreeDepth = depth + 1;
+		}
+		if (node->children > 0) {
+			if (depth == info->maxDepth || node->children > info->nodeCount - 1 - usedChildPtrs) {
+				status = VSS_ERR_CORRUPT;
+				break;
+			}
+			node->child = &childPtrs[usedChildPtrs];
+			usedChildPtrs += node->children;
+			stack[depth] = node;
+			fill[depth] = 0;
+			depth++;
+		}
+		while (depth > 0 && fill[depth-1] == stack[depth-1]->children) {
+			sortChildren(tree, stack[--depth]);
+		}
+		tree->readTreeMetadata.totalNodes++;
+	}
+	if (status == VSS_OK && depth != 0) {
+		status = VSS_ERR_CORRUPT;
+	}
+	free(stack);
+	free(fill);
+	return status;
+}
+
+/**
+ * decodeTreeV2() preallocates exactly the nodes and child pointers given by the header, and decodes each node
+ * from the position given by the node offset table. index holds the offset table followed by the node section.
+ **/
+node_t* decodeTreeV2(vssTree_t* tree, vssFileInfo_t* info, const uint8_t* index, stringPool_t* pool, int* status) {
+	size_t offsetTableLen = sizeof(uint32_t)*info->nodeCount;
+	node_t* nodes = (node_t*) arenaCalloc(tree, sizeof(node_t)*info->nodeCount);
+	node_t** childPtrs = (node_t**) arenaAlloc(tree, sizeof(node_t*)*(info->nodeCount > 1 ? info->nodeCount - 1 : 1));
+	*status = VSS_OK;
+	if (nodes == NULL || childPtrs == NULL) {
+		*status = VSS_ERR_NOMEM;
+	}
+	const uint8_t* nodeSection = index + offsetTableLen;
+	for (uint32_t i = 0 ; i < info->nodeCount && *status == VSS_OK ; i++) {
+		uint32_t offset = getUint32(&index[i*sizeof(uint32_t)]);
+		if (offset >= info->nodeSectionSize) {
+			*status = VSS_ERR_CORRUPT;
+			break;
+		}
+		nodes[i].tree = tree;
+		nodes[i].index = i;
+		*status = decodeNodeV2(tree, &nodes[i], nodeSection + offset, nodeSection + info->nodeSectionSize, pool);
+	}
+	if (*status == VSS_OK) {
+		*status = linkNodesV2(tree, nodes, childPtrs, info);
+	}
+	return *status == VSS_OK ? nodes : NULL;
+}
+
+/**
+ * A VSS_LOAD_LAZY tree keeps the node section and the string pool for the attributes that are decoded after the load.
+ **/
+void keepLazyRecords(vssTree_t* tree, vssFileInfo_t* info, const uint8_t* index, stringPool_t* pool) {
+	tree->lazyRecords = index + sizeof(uint32_t)*info->nodeCount;
+	tree->lazyRecordsLen = info->nodeSectionSize;
+	tree->lazyPool = *pool;
+}
+
+/**
+ * readTreeV2() reads the offset table and node section into a temporary buffer, or into the arena if the load is lazy, and the string pool into the arena.
+ * The descriptions at the end of the pool are not read if they are dropped.
+ **/
+node_t* readTreeV2(vssTree_t* tree, FILE* fp, vssFileInfo_t* info, bool lazy, int* status) {
+	size_t indexLen = sizeof(uint32_t)*info->nodeCount + info->nodeSectionSize;
+	uint8_t* index = (uint8_t*) (lazy == true ? arenaAlloc(tree, indexLen) : malloc(indexLen));
+	uint32_t poolSize = (tree->attributes & VSS_ATTR_DESCR) != 0 ? info->stringPoolSize : info->descrPoolOffset;
+	stringPool_t pool = {(char*) arenaAlloc(tree, poolSize), poolSize, info->descrPoolOffset, true};
+	node_t* nodes = NULL;
+	if (index == NULL || pool.buf == NULL) {
+		*status = VSS_ERR_NOMEM;
+	} else if (fread(index, 1, indexLen, fp) != indexLen || fread(pool.buf, 1, pool.size, fp) != pool.size) {
+		*status = VSS_ERR_TRUNCATED;
+	} else {
+		tree->stats.bytesRead = V2HEADERSIZE + indexLen + pool.size;
+		tree->stats.stringPoolBytes = pool.size;
+		if (lazy == true) {
+			keepLazyRecords(tree, info, index, &pool);
+		}
+		nodes = decodeTreeV2(tree, info, index, &pool, status);
+	}
+	if (lazy == false) {
+		free(index);
+	}
+	return nodes;
+}
+
+/**
+ * mapTreeV2() maps the file read-only, and decodes the nodes with their strings pointing into the mapping.
+ * The strings are not read at load time, so e.g. the descriptions, which the writer puts last in the pool,
+ * only become resident when they are accessed. The mapping is released with the tree.
+ **/
+node_t* mapTreeV2(vssTree_t* tree, FILE* fp, vssFileInfo_t* info, bool lazy, int* status) {
+	size_t indexLen = sizeof(uint32_t)*info->nodeCount + info->nodeSectionSize;
+	size_t mapLen = V2HEADERSIZE + indexLen + info->stringPoolSize;
+	uint8_t* map = (uint8_t*) mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+	if (map == MAP_FAILED) {
+		*status = VSS_ERR_NOMEM;
+		return NULL;
+	}
+	tree->map = map;
+	tree->mapLen = mapLen;
+	tree->stats.bytesRead = mapLen;
+	tree->stats.stringPoolBytes = info->stringPoolSize;
+	stringPool_t pool = {(char*)&map[V2HEADERSIZE + indexLen], info->stringPoolSize, info->descrPoolOffset, false};
+	if (pool.buf[pool.size-1] != '\0') {
+		*status = VSS_ERR_CORRUPT;
+		return NULL;
+	}
+	if (lazy == true) {
+		keepLazyRecords(tree, info, &map[V2HEADERSIZE], &pool);
+	}
+	return decodeTreeV2(tree, info, &map[V2HEADERSIZE], &pool, status);
+}
+
+/**
+ * buildCompactTree() copies the topology, types, validation and names of the nodes into the pre-order arrays of the compact tree.
+ **/
+int buildCompactTree(vssTree_t* tree, node_t* root) {
+	uint32_t nodeCount = (uint32_t)tree->readTreeMetadata.totalNodes;
+	vssCompactTree_t* compact = (vssCompactTree_t*) arenaCalloc(tree, sizeof(vssCompactTree_t));
+	if (compact == NULL) {
+		return VSS_ERR_NOMEM;
+	}
+	compact->nodeCount = nodeCount;
+	compact->parent = (uint32_t*) arenaAlloc(tree, sizeof(uint32_t)*nodeCount);
+	compact->subtreeEnd = (uint32_t*) arenaAlloc(tree, sizeof(uint32_t)*nodeCount);
+	compact->childCount = (uint32_t*) arenaAlloc(tree, sizeof(uint32_t)*nodeCount);
+	compact->nameOffset = (uint32_t*) arenaAlloc(tree, sizeof(uint32_t)*nodeCount);
+	compact->type = (uint8_t*) arenaAlloc(tree, sizeof(uint8_t)*nodeCount);
+	compact->validate = (uint8_t*) arenaAlloc(tree, sizeof(uint8_t)*nodeCount);
+	compact->inheritedValidate = (uint8_t*) arenaAlloc(tree, sizeof(uint8_t)*nodeCount);
+	compact->handles = (long*) arenaAlloc(tree, sizeof(long)*nodeCount);
+	if (compact->parent == NULL || compact->subtreeEnd == NULL || compact->childCount == NULL || compact->nameOffset == NULL ||
+	    compact->type == NULL || compact->validate == NULL || compact->inheritedValidate == NULL || compact->handles == NULL) {
+		return VSS_ERR_NOMEM;
+	}
+	size_t namesSize = 0;
+	node_t** stack = (node_t**) malloc(sizeof(node_t*)*nodeCount);  // pre-order walk, the children are pushed in reverse order
+	if (stack == NULL) {
+		return VSS_ERR_NOMEM;
+	}
+	uint32_t stackLen = 0;
+	stack[stackLen++] = root;
+	while (stackLen > 0) {
+		node_t* node = stack[--stackLen];
+		uint32_t i = node->index;
+		compact->handles[i] = (long)((intptr_t)node);
+		compact->parent[i] = node->parent != NULL ? node->parent->index : VSSNOINDEX;
+		compact->childCount[i] = node->children;
+		compact->type[i] = (uint8_t)node->type;
+		compact->validate[i] = node->validate;
+		compact->inheritedValidate[i] = node->inheritedValidate;
+		compact->subtreeEnd[i] = i + 1;
+		namesSize += node->nameLen + 1;
+		for (int childNo = node->children - 1 ; childNo >= 0 ; childNo--) {
+			stack[stackLen++] = node->child[childNo];
+		}
+	}
+	free(stack);
+	compact->names = (char*) arenaAlloc(tree, namesSize);
+	if (compact->names == NULL) {
+		return VSS_ERR_NOMEM;
+	}
+	uint32_t namesUsed = 0;
+	for (uint32_t i = 0 ; i < nodeCount ; i++) {
+		node_t* node = (node_t*)((intptr_t)compact->handles[i]);
+		compact->nameOffset[i] = namesUsed;
+		memcpy(&compact->names[namesUsed], node->name, node->nameLen);
+		compact->names[namesUsed + node->nameLen] = '\0';
+		namesUsed += node->nameLen + 1;
+	}
+	for (uint32_t i = nodeCount ; i-- > 1 ; ) {  // children have higher indices than their parent
+		if (compact->subtreeEnd[i] > compact->subtreeEnd[compact->parent[i]]) {
+			compact->subtreeEnd[compact->parent[i]] = compact->subtreeEnd[i];
+		}
+	}
+	tree->compact = compact;
+	return VSS_OK;
+}
+
+void insertPathSlot(pathSlot_t* slots, uint32_t mask, uint32_t hash, uint32_t index) {
+	uint32_t slot = hash & mask;
+	while (slots[slot].index != VSSNOINDEX) {
+		slot = (slot + 1) & mask;
+	}
+	slots[slot].hash = hash;
+	slots[slot].index = index;
+}
+
+/**
+ * buildPathIndex() hashes the path of every node incrementally from the hash of the path of its parent, and inserts it in both tables.
+ * The tables have at least twice as many slots as there are nodes, and nodes are inserted in pre-order, so that of paths that differ
+ * only in case the first one in pre-order is found by a case-insensitive lookup.
+ **/
+int buildPathIndex(vssTree_t* tree, node_t* root) {
+	uint32_t nodeCount = (uint32_t)tree->readTreeMetadata.totalNodes;
+	uint32_t numOfSlots = 16;
+	while (numOfSlots < 2 * nodeCount) {
+		numOfSlots *= 2;
+	}
+	pathIndex_t* pathIndex = (pathIndex_t*) arenaAlloc(tree, sizeof(pathIndex_t));
+	if (pathIndex == NULL) {
+		return VSS_ERR_NOMEM;
+	}
+	pathIndex->mask = numOfSlots - 1;
+	pathIndex->exact = (pathSlot_t*) arenaAlloc(tree, sizeof(pathSlot_t)*numOfSlots);
+	pathIndex->folded = (pathSlot_t*) arenaAlloc(tree, sizeof(pathSlot_t)*numOfSlots);
+	pathIndex->nodes = (node_t**) arenaAlloc(tree, sizeof(node_t*)*nodeCount);
+	if (pathIndex->exact == NULL || pathIndex->folded == NULL || pathIndex->nodes == NULL) {
+		return VSS_ERR_NOMEM;
+	}
+	memset(pathIndex->exact, 0xFF, sizeof(pathSlot_t)*numOfSlots);
+	memset(pathIndex->folded, 0xFF, sizeof(pathSlot_t)*numOfSlots);
+	uint32_t* hashes = (uint32_t*) malloc(sizeof(uint32_t)*2*nodeCount);  // exact and folded path hash of each index
+	node_t** stack = (node_t**) malloc(sizeof(node_t*)*nodeCount);
+	if (hashes == NULL || stack == NULL) {
+		free(hashes);
+		free(stack);
+		return VSS_ERR_NOMEM;
+	}
+	uint32_t stackLen = 0;
+	stack[stackLen++] = root;
+	while (stackLen > 0) {
+		node_t* node = stack[--stackLen];
+		uint32_t i = node->index;
+		uint32_t exactHash = FNVOFFSETBASIS;
+		uint32_t foldedHash = FNVOFFSETBASIS;
+		if (node->parent != NULL) {
+			exactHash = hashPathBytes(hashes[2*node->parent->index], ".", 1, false);
+			foldedHash = hashPathBytes(hashes[2*node->parent->index+1], ".", 1, true);
+		}
+		hashes[2*i] = hashPathBytes(exactHash, node->name, node->nameLen, false);
+		hashes[2*i+1] = hashPathBytes(foldedHash, node->name, node->nameLen, true);
+		pathIndex->nodes[i] = node;
+		insertPathSlot(pathIndex->exact, pathIndex->mask, hashes[2*i], i);
+		insertPathSlot(pathIndex->folded, pathIndex->mask, hashes[2*i+1], i);
+		for (int childNo = node->children - 1 ; childNo >= 0 ; childNo--) {
+			stack[stackLen++] = node->child[childNo];
+		}
+	}
+	free(hashes);
+	free(stack);
+	tree->pathIndex = pathIndex;
+	return VSS_OK;
+}
+
+/**
+ * Compares path with the names from node up to the root, starting at the end of path.
+ **/
+bool nodePathEquals(node_t* node, const char* path, size_t pathLen, bool caseInsensitive) {
+	size_t end = pathLen;
+	for ( ; node != NULL ; node = node->parent) {
+		if (end < node->nameLen) {
+			return false;
+		}
+		size_t start = end - node->nameLen;
+		if ((caseInsensitive == true ? strncasecmp(&path[start], node->name, node->nameLen) : memcmp(&path[start], node->name, node->nameLen)) != 0) {
+			return false;
+		}
+		if (node->parent == NULL) {
+			return start == 0;
+		}
+		if (start == 0 || path[start-1] != '.') {
+			return false;
+		}
+		end = start - 1;
+	}
+	return false;
+}
+
+/**
+ * Without a path index the path is resolved segment by segment from the root, with a binary search in the sorted children of nodes
+ * with many children, and a scan of the children of the other nodes on the path.
+ **/
+node_t* walkPath(node_t* root, const char* path, bool caseInsensitive) {
+	node_t* parent = NULL;
+	node_t** candidates = &root;
+	int numOfCandidates = 1;
+	const char* segment = path;
+	while (segment != NULL) {
+		const char* delim = strchr(segment, '.');
+		size_t len = delim != NULL ? (size_t)(delim - segment) : strlen(segment);
+		node_t* node = NULL;
+		if (caseInsensitive == false && parent != NULL && parent->sortedChild != NULL) {
+			uint32_t childNo = findSortedChild(parent, segment, len);
+			node = childNo < parent->children ? parent->sortedChild[childNo] : NULL;
+		} else {
+			for (int i = 0 ; i < numOfCandidates && node == NULL ; i++) {
+				if (candidates[i]->nameLen == len && (caseInsensitive == true ? strncasecmp(segment, candidates[i]->name, len) : memcmp(segment, candidates[i]->name, len)) == 0) {
+					node = candidates[i];
+				}
+			}
+		}
+		if (node == NULL) {
+			return NULL;
+		}
+		parent = node;
+		candidates = node->child;
+		numOfCandidates = node->children;
+		segment = delim != NULL ? delim + 1 : NULL;
+	}
+	return parent;
+}
+
+long VSSLookupPath(long rootHandle, const char* path, bool caseInsensitive) {
+	node_t* root = (node_t*)((intptr_t)rootHandle);
+	pathIndex_t* pathIndex = root->tree->pathIndex;
+	if (pathIndex == NULL) {
+		while (root->parent != NULL) {
+			root = root->parent;
+		}
+		return (long)((intptr_t)walkPath(root, path, caseInsensitive));
+	}
+	size_t pathLen = strlen(path);
+	uint32_t hash = hashPathBytes(FNVOFFSETBASIS, path, pathLen, caseInsensitive);
+	pathSlot_t* slots = caseInsensitive == true ? pathIndex->folded : pathIndex->exact;
+	for (uint32_t slot = hash & pathIndex->mask ; slots[slot].index != VSSNOINDEX ; slot = (slot + 1) & pathIndex->mask) {
+		if (slots[slot].hash == hash && nodePathEquals(pathIndex->nodes[slots[slot].index], path, pathLen, caseInsensitive) == true) {
+			return (long)((intptr_t)pathIndex->nodes[slots[slot].index]);
+		}
+	}
+	return 0;
+}
+
+typedef struct compactSearch_t {
+	vssCompactTree_t* compact;
+	bool leafNodesOnly;
+	uint32_t* found;
+	int maxFound;
+	int numOfMatches;
+} compactSearch_t;
+
+bool compactNameMatch(vssCompactTree_t* compact, uint32_t index, const vssPatternSegment_t* segment) {
+	const char* name = &compact->names[compact->nameOffset[index]];
+	return segment->wildcard == true || (strncmp(name, segment->name, segment->len) == 0 && name[segment->len] == '\0');
+}
+
+void compactSaveMatch(compactSearch_t* search, uint32_t index) {
+	uint8_t type = search->compact->type[index];
+	if (search->leafNodesOnly == true && (type == BRANCH || type == STRUCT)) {
+		return;
+	}
+	if (search->numOfMatches < search->maxFound) {
+		search->found[search->numOfMatches] = index;
+	}
+	search->numOfMatches++;
+}
+
+/**
+ * A node on the path from the search root to the node in focus, with the state of the visit of its children.
+ **/
+typedef struct searchFrame_t {
+	node_t* node;
+	const vssPatternSegment_t* childSegment;
+	uint32_t childNo;  // the next child to compare, in sortedChild order if sorted is true
+	bool sorted;  // only the children named as childSegment are visited, which are adjacent in sortedChild and in pre-order
+	int numOfSavedBefore;
+	int speculationSucceded;  // by the node itself or by a node below it
+} searchFrame_t;
+
+/**
+ * enterNode() matches the node against the segment at its depth, and sets up the visit of the children that can match the next segment.
+ **/
+static inline void enterNode(node_t* node, searchFrame_t* frame, SearchContext_t* context) {
+	long thisNode = (long)((intptr_t)node);
+	frame->node = node;
+	frame->childNo = node->children;  // no child is visited unless the node matches
+	frame->sorted = false;
+	frame->numOfSavedBefore = context->numOfSaved;
+	frame->speculationSucceded = 0;
+	incDepth(context);
+	if (compareNodeName(thisNode, getPathSegment(0, context)) == true) {
+		bool done;
+		frame->speculationSucceded = saveMatchingNode(thisNode, context, &done);
+		if (done == false) {
+			frame->childSegment = getPathSegment(1, context);
+			frame->sorted = frame->childSegment->wildcard == false && node->sortedChild != NULL;
+			frame->childNo = frame->sorted == true ? findSortedChild(node, frame->childSegment->name, frame->childSegment->len) : 0;
+		}
+	}
+}
+
+/**
+ * Returns the next child of the node of the frame that matches the child segment, or NULL if there is none left.
+ **/
+static inline node_t* nextMatchingChild(searchFrame_t* frame) {
+	node_t* node = frame->node;
+	if (frame->sorted == true) {
+		if (frame->childNo < node->children && compareNodeName((long)((intptr_t)node->sortedChild[frame->childNo]), frame->childSegment) == true) {
+			return node->sortedChild[frame->childNo++];
+		}
+		frame->childNo = node->children;
+		return NULL;
+	}
+	while (frame->childNo < node->children) {
+		node_t* child = node->child[frame->childNo++];
+		if (compareNodeName((long)((intptr_t)child), frame->childSegment) == true) {
+			return child;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * traverseTree() searches the subtree of rootNode in pre-order with a stack of frames instead of recursion, so the depth of the tree
+ * is only limited by memory. A node is left, and its speculation decided by decDepth(), when no more of its children can match.
+ **/
+void traverseTree(long rootNode, SearchContext_t* context) {
+	searchFrame_t frameBuf[SEARCHSTACKBUFLEN];
+	searchFrame_t* frames = frameBuf;
+	int size = SEARCHSTACKBUFLEN;
+	int depth = 1;
+	enterNode((node_t*)((intptr_t)rootNode), &frames[0], context);
+	while (depth > 0) {
+		node_t* child = context->stopped == false ? nextMatchingChild(&frames[depth-1]) : NULL;
+		if (child != NULL && child->children == 0) {  // most nodes are leaves, which are entered and left without a push
+			searchFrame_t leaf;
+			enterNode(child, &leaf, context);
+			decDepth(leaf.speculationSucceded, leaf.numOfSavedBefore, context);
+			frames[depth-1].speculationSucceded += leaf.speculationSucceded;
+			continue;
+		}
+		if (child != NULL && depth == size) {
+			searchFrame_t* grown = (searchFrame_t*) malloc(sizeof(searchFrame_t)*2*size);
+			if (grown == NULL) {
+				context->outOfMemory = true;
+				context->stopped = true;
+				continue;
+			}
+			memcpy(grown, frames, sizeof(searchFrame_t)*size);
+			if (frames != frameBuf) {
+				free(frames);
+			}
+			frames = grown;
+			size *= 2;
+		}
+		if (child != NULL) {
+			enterNode(child, &frames[depth++], context);
+			continue;
+		}
+		searchFrame_t* frame = &frames[--depth];
+		decDepth(frame->speculationSucceded, frame->numOfSavedBefore, context);
+		if (depth > 0) {
+			frames[depth-1].speculationSucceded += frame->speculationSucceded;
+		}
+	}
+	if (frames != frameBuf) {
+		free(frames);
+	}
+}
+
+void initContext(SearchContext_t* context, vssPattern_t* pattern, long rootNode, vssMatchCallback_t callback, void* userData, bool anyDepth, bool leafNodesOnly, int listSize, noScopeList_t* noScopeList) {
+	context->pattern = pattern;
+	context->rootNode = rootNode;
+	context->callback = callback;
+	context->userData = userData;
+	if (anyDepth == true) {
+		context->maxDepth = INT_MAX;  // the depth of the tree is not limited
+	} else {
+		context->maxDepth = context->pattern->numOfSegments;
+	}
+	context->leafNodesOnly = leafNodesOnly;
+	context->listSize = listSize;
+ 	context->noScopeList = NULL;
+	if (listSize > 0) {
+  	    context->noScopeList = noScopeList;
+	}
+	context->maxValidation = 0;
+	context->currentDepth = 0;
+	context->matchPath[0] = 0;
+	context->numOfSaved = 0;
+	context->numOfMatches = 0;
+	context->pending = context->pendingBuf;
+	context->pendingSize = PENDINGBUFLEN;
+	context->stopped = false;
+	context->outOfMemory = false;
+	context->speculationIndex = -1;
+}
+
+long VSSReadTree(char* filePath) {
+	return VSSLoadTree(filePath, VSS_LOAD_DEFAULT, NULL);
+}
+
+long VSSLoadTree(char* filePath, int loadFlags, int* status) {
+	return VSSLoadTreeAttributes(filePath, loadFlags, VSS_ATTR_ALL, status);
+}
+
+long VSSLoadTreeAttributes(char* filePath, int loadFlags, int attributes, int* status) {
+	int loadStatus;
+	if (status == NULL) {
+		status = &loadStatus;
+	}
+	bool quiet = (loadFlags & VSS_LOAD_QUIET) != 0;
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	FILE* treeFp = fopen(filePath, "r");
+	if (treeFp == NULL) {
+		if (quiet == false) {
+			printf("Could not open file for reading tree data\n");
+		}
+		*status = VSS_ERR_OPEN;
+		return 0;
+	}
+	vssFileInfo_t info;
+	*status = readFileInfo(treeFp, &info);
+	vssTree_t* tree = (vssTree_t*) calloc(1, sizeof(vssTree_t));
+	intptr_t root = 0;
+	if (tree != NULL) {
+		tree->rangeCache = (rangeCacheEntry_t*) calloc(RANGECACHESIZE, sizeof(rangeCacheEntry_t));  // without it the ranges are not shared
+		tree->attributes = attributes & VSS_ATTR_ALL;
+		tree->quiet = quiet;
+		pthread_mutex_init(&tree->lazyLock, NULL);
+		tree->stats.allocations = 1;
+		tree->stats.allocatedBytes = sizeof(vssTree_t);
+	}
+	if (tree == NULL) {
+		*status = VSS_ERR_NOMEM;
+	} else if (*status == VSS_OK && info.version == 2 && (loadFlags & VSS_LOAD_MMAP) != 0) {
+		root = (intptr_t)mapTreeV2(tree, treeFp, &info, (loadFlags & VSS_LOAD_LAZY) != 0, status);
+	} else if (*status == VSS_OK && info.version == 2) {
+		root = (intptr_t)readTreeV2(tree, treeFp, &info, (loadFlags & VSS_LOAD_LAZY) != 0, status);
+	} else if (*status == VSS_OK) {
+		tree->strings = newStringTable();  // without it the strings are not shared
+		root = (intptr_t)readTreeV1(tree, treeFp, status);
+		freeStringTable(tree->strings);
+		tree->strings = NULL;
+	}
+	if (tree != NULL) {
+		free(tree->rangeCache);
+		tree->rangeCache = NULL;
+	}
+	fclose(treeFp);
+	if (*status == VSS_OK && (loadFlags & VSS_LOAD_COMPACT) != 0) {
+		*status = buildCompactTree(tree, (node_t*)root);
+	}
+	if (*status == VSS_OK && (loadFlags & VSS_LOAD_PATHINDEX) != 0) {
+		*status = buildPathIndex(tree, (node_t*)root);
+	}
+	if (*status != VSS_OK) {
+		if (quiet == false) {
+			printf("Could not read tree data: %s\n", VSSGetStatusText(*status));
+		}
+		if (tree != NULL) {
+			freeTree(tree);
+		}
+		return 0;
+	}
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	tree->stats.loadNs = (uint64_t)(end.tv_sec - start.tv_sec)*1000000000 + (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+	if (quiet == false) {
+		printReadMetadata(tree);
+	}
+	return (long)root;
+}
+
+void VSSFreeTree(long rootHandle) {
+	if (rootHandle != 0) {
+		freeTree(((node_t*)((intptr_t)rootHandle))->tree);
+	}
+}
+
+/**
+ * The decoding of the attributes of a VSS_LOAD_LAZY tree updates the accounting and the allocations under the lazy lock, so they are read under it.
+ **/
+void VSSGetAttributeBytes(long rootHandle, vssAttributeBytes_t* bytes) {
+	vssTree_t* tree = ((node_t*)((intptr_t)rootHandle))->tree;
+	pthread_mutex_lock(&tree->lazyLock);
+	*bytes = tree->attributeBytes;
+	pthread_mutex_unlock(&tree->lazyLock);
+}
+
+void VSSGetTreeStats(long rootHandle, vssTreeStats_t* stats) {
+	vssTree_t* tree = ((node_t*)((intptr_t)rootHandle))->tree;
+	pthread_mutex_lock(&tree->lazyLock);
+	*stats = tree->stats;
+	pthread_mutex_unlock(&tree->lazyLock);
+	stats->totalNodes = (uint32_t)tree->readTreeMetadata.totalNodes;
+	stats->maxDepth = (uint32_t)tree->readTreeMetadata.maxTreeDepth;
+}
+
+vssCompactTree_t* VSSGetCompactTree(long rootHandle) {
+	return ((node_t*)((intptr_t)rootHandle))->tree->compact;
+}
+
+/**
+ * The search walks the compact arrays without recursion. Nodes that match a non-final segment push their matching children,
+ * and a final wildcard with anyDepth matches the whole subtree, which is a linear scan of the index range of the subtree.
+ **/
+int VSSCompactSearchPattern(vssCompactTree_t* compact, vssPattern_t* pattern, bool anyDepth, bool leafNodesOnly, uint32_t* found, int maxFound) {
+	if (pattern == NULL || pattern->numOfSegments == 0) {
+		return 0;
+	}
+	int numOfSegments = pattern->numOfSegments;
+	vssPatternSegment_t* segments = pattern->segments;
+	uint32_t* stack = (uint32_t*) malloc(sizeof(uint32_t)*2*compact->nodeCount);  // (node index, segment index) pairs
+	if (stack == NULL) {
+		return -1;
+	}
+	bool subtreeWildcard = anyDepth == true && pattern->trailingWildcard == true;
+	compactSearch_t search = {compact, leafNodesOnly, found, maxFound, 0};
+	uint32_t stackLen = 0;
+	if (compactNameMatch(compact, 0, &segments[0]) == true) {
+		stack[stackLen++] = 0;
+		stack[stackLen++] = 0;
+	}
+	while (stackLen > 0) {
+		uint32_t segmentNo = stack[--stackLen];
+		uint32_t index = stack[--stackLen];
+		if (segmentNo == (uint32_t)numOfSegments - 1) {
+			compactSaveMatch(&search, index);
+			if (subtreeWildcard == true) {
+				for (uint32_t i = index + 1 ; i < compact->subtreeEnd[index] ; i++) {
+					compactSaveMatch(&search, i);
+				}
+			}
+			continue;
+		}
+		uint32_t lastChild = stackLen;
+		for (uint32_t child = index + 1 ; child < compact->subtreeEnd[index] ; child = compact->subtreeEnd[child]) {
+			if (compactNameMatch(compact, child, &segments[segmentNo+1]) == true) {
+				stack[stackLen++] = child;
+				stack[stackLen++] = segmentNo + 1;
+			}
+		}
+		for (uint32_t low = lastChild, high = stackLen ; high - low > 2 ; low += 2, high -= 2) {  // pop the children in pre-order
+			uint32_t tmpIndex = stack[low], tmpSegment = stack[low+1];
+			stack[low] = stack[high-2];
+			stack[low+1] = stack[high-1];
+			stack[high-2] = tmpIndex;
+			stack[high-1] = tmpSegment;
+		}
+	}
+	free(stack);
+	return search.numOfMatches;
+}
+
+int VSSCompactSearch(vssCompactTree_t* compact, char* searchPath, bool anyDepth, bool leafNodesOnly, uint32_t* found, int maxFound) {
+	localPattern_t local;
+	vssPattern_t* pattern = compileLocalPattern(&local, searchPath);
+	if (pattern == NULL) {
+		return -1;
+	}
+	int matches = VSSCompactSearchPattern(compact, pattern, anyDepth, leafNodesOnly, found, maxFound);
+	VSSFreePattern(local.compiled);
+	return matches;
+}
+
+/**
+ * A batch is a trie over the segments of its patterns, where patterns with a common prefix share the states of the prefix.
+ * A state has its literal transitions sorted by segment, at most one wildcard transition, and the patterns that end in it.
+ **/
+typedef struct batchTransition_t {
+	uint32_t from;
+	uint32_t to;
+	const vssPatternSegment_t* segment;
+} batchTransition_t;
+
+typedef struct batchState_t {
+	uint32_t firstTransition;  // literal transitions of the state in batch->transitions
+	uint32_t numOfTransitions;
+	uint32_t wildcard;         // state after a '*' segment, or VSSNOINDEX
+	uint32_t firstAccept;      // patterns that end in the state in batch->accepts
+	uint32_t numOfAccepts;
+	bool subtree;              // entered by a '*' segment, so its patterns match the whole subtree in an anyDepth search
+} batchState_t;
+
+struct vssBatch_t {
+	int numOfPatterns;
+	vssPattern_t** patterns;
+	uint32_t numOfStates;
+	batchState_t* states;
+	batchTransition_t* transitions;
+	uint32_t* accepts;
+};
+
+int compareSegments(const vssPatternSegment_t* segment, const char* name, uint32_t len) {
+	if (segment->len != len) {
+		return segment->len < len ? -1 : 1;
+	}
+	return memcmp(segment->name, name, len);
+}
+
+int compareTransitions(const void* a, const void* b) {
+	const batchTransition_t* transition1 = (const batchTransition_t*)a;
+	const batchTransition_t* transition2 = (const batchTransition_t*)b;
+	if (transition1->from != transition2->from) {
+		return transition1->from < transition2->from ? -1 : 1;
+	}
+	return compareSegments(transition1->segment, transition2->segment->name, transition2->segment->len);
+}
+
+int compareAccepts(const void* a, const void* b) {  // (state, pattern) pairs
+	const uint32_t* accept1 = (const uint32_t*)a;
+	const uint32_t* accept2 = (const uint32_t*)b;
+	if (accept1[0] != accept2[0]) {
+		return accept1[0] < accept2[0] ? -1 : 1;
+	}
+	return accept1[1] < accept2[1] ? -1 : accept1[1] > accept2[1];
+}
+
+void VSSFreeBatch(vssBatch_t* batch) {
+	if (batch == NULL) {
+		return;
+	}
+	for (int i = 0 ; i < batch->numOfPatterns && batch->patterns != NULL ; i++) {
+		VSSFreePattern(batch->patterns[i]);
+	}
+	free(batch->patterns);
+	free(batch->states);
+	free(batch->transitions);
+	free(batch->accepts);
+	free(batch);
+}
+
+uint32_t newBatchState(vssBatch_t* batch, bool subtree) {
+	batchState_t* state = &(batch->states[batch->numOfStates]);
+	state->numOfTransitions = 0;
+	state->wildcard = VSSNOINDEX;
+	state->numOfAccepts = 0;
+	state->subtree = subtree;
+	return batch->numOfStates++;
+}
+
+/**
+ * VSSCompileBatch() inserts the segments of each pattern in the trie, with a hash table of (state, segment) for the literal transitions,
+ * and then sorts the transitions and the accepting states, so that each state owns a sorted range of both.
+ **/
+vssBatch_t* VSSCompileBatch(char** searchPaths, int numOfPaths) {
+	vssBatch_t* batch = (vssBatch_t*) calloc(1, sizeof(vssBatch_t));
+	if (batch == NULL) {
+		return NULL;
+	}
+	batch->patterns = (vssPattern_t**) calloc(numOfPaths > 0 ? numOfPaths : 1, sizeof(vssPattern_t*));
+	if (batch->patterns == NULL) {
+		VSSFreeBatch(batch);
+		return NULL;
+	}
+	batch->numOfPatterns = numOfPaths;
+	uint32_t numOfSegments = 0;
+	for (int i = 0 ; i < numOfPaths ; i++) {
+		if (countSegments(searchPaths[i]) > 0) {
+			batch->patterns[i] = VSSCompilePattern(searchPaths[i]);
+			if (batch->patterns[i] == NULL) {
+				VSSFreeBatch(batch);
+				return NULL;
+			}
+			numOfSegments += batch->patterns[i]->numOfSegments;
+		}
+	}
+	uint32_t numOfSlots = 16;
+	while (numOfSlots < 2 * numOfSegments) {
+		numOfSlots *= 2;
+	}
+	batch->states = (batchState_t*) malloc(sizeof(batchState_t)*(numOfSegments + 1));
+	batch->transitions = (batchTransition_t*) malloc(sizeof(batchTransition_t)*(numOfSegments + 1));
+	batch->accepts = (uint32_t*) malloc(sizeof(uint32_t)*2*(numOfPaths + 1));  // (state, pattern) pairs until sorted
+	uint32_t* slots = (uint32_t*) malloc(sizeof(uint32_t)*numOfSlots);
+	if (batch->states == NULL || batch->transitions == NULL || batch->accepts == NULL || slots == NULL) {
+		free(slots);
+		VSSFreeBatch(batch);
+		return NULL;
+	}
+	memset(slots, 0xFF, sizeof(uint32_t)*numOfSlots);
+	newBatchState(batch, false);
+	uint32_t numOfTransitions = 0;
+	uint32_t numOfAccepts = 0;
+	for (int i = 0 ; i < numOfPaths ; i++) {
+		vssPattern_t* pattern = batch->patterns[i];
+		if (pattern == NULL) {
+			continue;
+		}
+		uint32_t state = 0;
+		for (int segmentNo = 0 ; segmentNo < pattern->numOfSegments ; segmentNo++) {
+			const vssPatternSegment_t* segment = &(pattern->segments[segmentNo]);
+			if (segment->wildcard == true) {
+				if (batch->states[state].wildcard == VSSNOINDEX) {
+					batch->states[state].wildcard = newBatchState(batch, true);
+				}
+				state = batch->states[state].wildcard;
+				continue;
+			}
+			uint32_t hash = hashPathBytes(hashPathBytes(FNVOFFSETBASIS, (const char*)&state, sizeof(state), false), segment->name, segment->len, false);
+			uint32_t slot = hash & (numOfSlots - 1);
+			while (slots[slot] != VSSNOINDEX) {
+				batchTransition_t* transition = &(batch->transitions[slots[slot]]);
+				if (transition->from == state && compareSegments(transition->segment, segment->name, segment->len) == 0) {
+					break;
+				}
+				slot = (slot + 1) & (numOfSlots - 1);
+			}
+			if (slots[slot] == VSSNOINDEX) {
+				batch->transitions[numOfTransitions].from = state;
+				batch->transitions[numOfTransitions].segment = segment;
+				batch->transitions[numOfTransitions].to = newBatchState(batch, false);
+				slots[slot] = numOfTransitions++;
+			}
+			state = batch->transitions[slots[slot]].to;
+		}
+		batch->accepts[2*numOfAccepts] = state;
+		batch->accepts[2*numOfAccepts+1] = (uint32_t)i;
+		numOfAccepts++;
+	}
+	free(slots);
+	qsort(batch->transitions, numOfTransitions, sizeof(batchTransition_t), compareTransitions);
+	for (uint32_t i = numOfTransitions ; i-- > 0 ; ) {
+		batch->states[batch->transitions[i].from].firstTransition = i;
+		batch->states[batch->transitions[i].from].numOfTransitions++;
+	}
+	qsort(batch->accepts, numOfAccepts, 2*sizeof(uint32_t), compareAccepts);
+	for (uint32_t i = 0 ; i < numOfAccepts ; i++) {
+		uint32_t state = batch->accepts[2*i];
+		if (batch->states[state].numOfAccepts++ == 0) {
+			batch->states[state].firstAccept = i;
+		}
+		batch->accepts[i] = batch->accepts[2*i+1];  // compacts the pairs to pattern numbers in place, i <= 2*i
+	}
+	return batch;
+}
+
+#define BATCHSUBTREEFLAG 0x80000000u  // set on a state in the active states of a node if the patterns of the state match the whole subtree
+
+typedef struct batchFrame_t {
+	node_t* node;
+	uint32_t childNo;
+	uint32_t setStart;  // the active states of the node are set[setStart] to set[setEnd-1]
+	uint32_t setEnd;
+} batchFrame_t;
+
+typedef struct batchSearch_t {
+	vssBatch_t* batch;
+	bool anyDepth;
+	bool leafNodesOnly;
+	vssBatchCallback_t callback;
+	void* userData;
+	uint32_t* set;
+	uint32_t setLen;
+	uint32_t setSize;
+	int numOfMatches;
+	bool stopped;
+	bool outOfMemory;
+} batchSearch_t;
+
+void pushBatchState(batchSearch_t* search, uint32_t state) {
+	if (search->setLen == search->setSize) {
+		uint32_t* set = (uint32_t*) realloc(search->set, sizeof(uint32_t)*2*search->setSize);
+		if (set == NULL) {
+			search->outOfMemory = true;
+			search->stopped = true;
+			return;
+		}
+		search->set = set;
+		search->setSize *= 2;
+	}
+	search->set[search->setLen++] = state;
+}
+
+uint32_t findBatchTransition(vssBatch_t* batch, batchState_t* state, node_t* node) {
+	uint32_t low = state->firstTransition;
+	uint32_t high = state->firstTransition + state->numOfTransitions;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		int cmp = compareSegments(batch->transitions[middle].segment, node->name, node->nameLen);
+		if (cmp == 0) {
+			return batch->transitions[middle].to;
+		}
+		if (cmp < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return VSSNOINDEX;
+}
+
+/**
+ * Appends the active states of node, which are the transitions on its name from the active states of its parent, set[from] to set[to-1].
+ **/
+void stepBatchStates(batchSearch_t* search, node_t* node, uint32_t from, uint32_t to) {
+	for (uint32_t i = from ; i < to && search->stopped == false ; i++) {
+		uint32_t entry = search->set[i];
+		if ((entry & BATCHSUBTREEFLAG) != 0) {
+			pushBatchState(search, entry);
+			continue;
+		}
+		batchState_t* state = &(search->batch->states[entry]);
+		if (state->subtree == true && state->numOfAccepts > 0 && search->anyDepth == true) {
+			pushBatchState(search, entry | BATCHSUBTREEFLAG);
+		}
+		uint32_t next = findBatchTransition(search->batch, state, node);
+		if (next != VSSNOINDEX) {
+			pushBatchState(search, next);
+		}
+		if (state->wildcard != VSSNOINDEX) {
+			pushBatchState(search, state->wildcard);
+		}
+	}
+}
+
+void emitBatchMatches(batchSearch_t* search, node_t* node, uint32_t from, uint32_t to) {
+	if (search->leafNodesOnly == true && (node->type == BRANCH || node->type == STRUCT)) {
+		return;
+	}
+	for (uint32_t i = from ; i < to && search->stopped == false ; i++) {
+		batchState_t* state = &(search->batch->states[search->set[i] & ~BATCHSUBTREEFLAG]);
+		for (uint32_t j = 0 ; j < state->numOfAccepts && search->stopped == false ; j++) {
+			search->numOfMatches++;
+			if (search->callback((int)search->batch->accepts[state->firstAccept + j], (long)((intptr_t)node), search->userData) != 0) {
+				search->stopped = true;
+			}
+		}
+	}
+}
+
+/**
+ * The search is a pre-order walk with an explicit stack of frames, and the active states of the nodes on the stack are kept in one array,
+ * so a node whose name leads to no state is skipped with its subtree, and the memory is proportional to the depth times the active states.
+ **/
+int VSSSearchBatch(vssBatch_t* batch, long rootNode, bool anyDepth, bool leafNodesOnly, vssBatchCallback_t callback, void* userData) {
+	batchSearch_t search = {batch, anyDepth, leafNodesOnly, callback, userData, NULL, 0, 64, 0, false, false};
+	uint32_t framesSize = 16;
+	uint32_t numOfFrames = 0;
+	batchFrame_t* frames = (batchFrame_t*) malloc(sizeof(batchFrame_t)*framesSize);
+	search.set = (uint32_t*) malloc(sizeof(uint32_t)*search.setSize);
+	if (batch == NULL || frames == NULL || search.set == NULL) {
+		free(frames);
+		free(search.set);
+		return batch == NULL ? 0 : -1;
+	}
+	node_t* root = (node_t*)((intptr_t)rootNode);
+	pushBatchState(&search, 0);  // the trie root is the active state above the root node
+	stepBatchStates(&search, root, 0, 1);
+	if (search.setLen > 1) {
+		emitBatchMatches(&search, root, 1, search.setLen);
+		frames[numOfFrames++] = (batchFrame_t){root, 0, 1, search.setLen};
+	}
+	while (numOfFrames > 0 && search.stopped == false) {
+		batchFrame_t* frame = &frames[numOfFrames-1];
+		if (frame->childNo == frame->node->children) {
+			search.setLen = frame->setStart;
+			numOfFrames--;
+			continue;
+		}
+		node_t* child = frame->node->child[frame->childNo++];
+		uint32_t childStart = search.setLen;
+		stepBatchStates(&search, child, frame->setStart, frame->setEnd);
+		if (search.setLen == childStart) {
+			continue;
+		}
+		emitBatchMatches(&search, child, childStart, search.setLen);
+		if (numOfFrames == framesSize) {
+			batchFrame_t* grown = (batchFrame_t*) realloc(frames, sizeof(batchFrame_t)*2*framesSize);
+			if (grown == NULL) {
+				search.outOfMemory = true;
+				break;
+			}
+			frames = grown;
+			framesSize *= 2;
+		}
+		frames[numOfFrames++] = (batchFrame_t){child, 0, childStart, search.setLen};
+	}
+	free(frames);
+	free(search.set);
+	return search.outOfMemory == true ? -1 : search.numOfMatches;
+}
+
+uint32_t VSSgetIndex(long nodeHandle) {
+	return ((node_t*)((intptr_t)nodeHandle))->index;
+}
+
+int VSSGetFileInfo(char* filePath, vssFileInfo_t* info) {
+	FILE* fp = fopen(filePath, "r");
+	if (fp == NULL) {
+		return VSS_ERR_OPEN;
+	}
+	int status = readFileInfo(fp, info);
+	fclose(fp);
+	return status;
+}
+
+char* VSSGetStatusText(int status) {
+	switch (status) {
+		case VSS_OK: return "ok";
+		case VSS_ERR_OPEN: return "file could not be opened";
+		case VSS_ERR_FORMAT: return "unknown file format";
+		case VSS_ERR_VERSION: return "unsupported format version";
+		case VSS_ERR_ENDIANNESS: return "unsupported endianness";
+		case VSS_ERR_TRUNCATED: return "file is truncated";
+		case VSS_ERR_CORRUPT: return "file is corrupt";
+		case VSS_ERR_NOMEM: return "out of memory";
+		case VSS_ERR_LIMIT: return "tree exceeds a limit of the in-memory node representation";
+	}
+	return "unknown status";
+}
+
+vssPattern_t* VSSCompilePattern(char* searchPath) {
+	int numOfSegments = countSegments(searchPath);
+	if (numOfSegments == 0) {
+		return NULL;
+	}
+	size_t pathLen = strlen(searchPath);
+	vssPattern_t* pattern = (vssPattern_t*) malloc(sizeof(vssPattern_t) + sizeof(vssPatternSegment_t)*numOfSegments + pathLen + 1);
+	if (pattern == NULL) {
+		return NULL;
+	}
+	vssPatternSegment_t* segments = (vssPatternSegment_t*)&pattern[1];
+	char* path = (char*)&segments[numOfSegments];
+	memcpy(path, searchPath, pathLen + 1);
+	splitPattern(pattern, path, segments, numOfSegments);
+	return pattern;
+}
+
+void VSSFreePattern(vssPattern_t* pattern) {
+	free(pattern);
+}
+
+int VSSSearchStream(vssPattern_t* pattern, long rootNode, bool anyDepth, bool leafNodesOnly, int listSize, noScopeList_t* noScopeList, vssMatchCallback_t callback, void* userData, int* validation) {
+	struct SearchContext_t searchContext;
+	struct SearchContext_t* context = &searchContext;
+
+	if (validation != NULL) {
+		*validation = 0;
+	}
+	if (pattern == NULL || pattern->numOfSegments == 0) {
+		return 0;
+	}
+	initContext(context, pattern, rootNode, callback, userData, anyDepth, leafNodesOnly, listSize, noScopeList);
+	traverseTree(rootNode, context);
+	if (context->pending != context->pendingBuf) {
+		free(context->pending);
+	}
+	if (validation != NULL) {
+		*validation = context->maxValidation;
+	}
+	return context->outOfMemory == true ? -1 : context->numOfMatches;
+}
+
+int VSSGetPath(long nodeHandle, long rootNode, char* buf, int bufSize) {
+	node_t* root = (node_t*)((intptr_t)rootNode);
+	node_t* node;
+	int pathLen = -1;
+	for (node = (node_t*)((intptr_t)nodeHandle) ; ; node = node->parent) {
+		pathLen += node->nameLen + 1;
+		if (node == root || node->parent == NULL) {
+			break;
+		}
+	}
+	if (pathLen >= bufSize) {
+		return -1;
+	}
+	int pos = pathLen;
+	buf[pos] = '\0';
+	for (node = (node_t*)((intptr_t)nodeHandle) ; ; node = node->parent) {
+		pos -= node->nameLen;
+		memcpy(&buf[pos], node->name, node->nameLen);
+		if (node == root || node->parent == NULL) {
+			break;
+		}
+		buf[--pos] = '.';
+	}
+	return pathLen;
+}
+
+typedef struct searchDataSink_t {
+	long rootNode;
+	searchData_t* searchData;
+	int maxFound;
+	int numOfMatches;
+} searchDataSink_t;
+
+int saveSearchData(long nodeHandle, void* userData) {
+	searchDataSink_t* sink = (searchDataSink_t*)userData;
+	if (sink->numOfMatches < sink->maxFound) {
+		searchData_t* entry = &(sink->searchData[sink->numOfMatches]);
+		entry->foundNodeHandles = nodeHandle;
+		if (VSSGetPath(nodeHandle, sink->rootNode, entry->responsePaths, MAXCHARSPATH) < 0) {
+			entry->responsePaths[0] = '\0';
+		}
+	}
+	sink->numOfMatches++;
+	return 0;
+}
+
+int VSSSearchPattern(vssPattern_t* pattern, long rootNode, int maxFound, searchData_t* searchData, bool anyDepth,  bool leafNodesOnly, int listSize, noScopeList_t* noScopeList, int* validation) {
+	searchDataSink_t sink = {rootNode, searchData, maxFound, 0};
+	int matches = VSSSearchStream(pattern, rootNode, anyDepth, leafNodesOnly, listSize, noScopeList, saveSearchData, &sink, validation);
+	return matches > maxFound ? maxFound : matches;  // the number of entries written, as callers loop over them
+}
+
+int VSSSearchNodes(char* searchPath, long rootNode, int maxFound, searchData_t* searchData, bool anyDepth,  bool leafNodesOnly, int listSize, noScopeList_t* noScopeList, int* validation) {
+	localPattern_t local;
+	int matches = VSSSearchPattern(compileLocalPattern(&local, searchPath), rootNode, maxFound, searchData, anyDepth, leafNodesOnly, listSize, noScopeList, validation);
+	VSSFreePattern(local.compiled);
+	return matches;
+}
+
+typedef struct listSink_t {
+	long rootNode;
+	FILE* listFp;
+	bool withUuid;
+	int numOfMatches;
+	path_t path;
+} listSink_t;
+
+int writeListEntry(long nodeHandle, void* userData) {
+	listSink_t* sink = (listSink_t*)userData;
+	int pathLen = VSSGetPath(nodeHandle, sink->rootNode, sink->path, MAXCHARSPATH);
+	if (pathLen < 0) {
+		pathLen = 0;
+	}
+	if (sink->withUuid == false) {
+	    if (sink->numOfMatches == 0) {
+		    fwrite("\"", 1, 1, sink->listFp);
+	    } else {
+		    fwrite(", \"", 3, 1, sink->listFp);
+	    }
+	    fwrite(sink->path, pathLen, 1, sink->listFp);
+	    fwrite("\"", 1, 1, sink->listFp);
+	} else {
+	    if (sink->numOfMatches == 0) {
+		    fwrite("{\"", 2, 1, sink->listFp);
+	    } else {
+		    fwrite(", {\"", 4, 1, sink->listFp);
+	    }
+	    fwrite(sink->path, pathLen, 1, sink->listFp);
+	    fwrite("\", \"", 4, 1, sink->listFp);
+	    char* uuid = VSSgetUUID(nodeHandle);  // NULL if the uuids are dropped
+	    if (uuid != NULL) {
+	        fwrite(uuid, strlen(uuid), 1, sink->listFp);
+	    }
+	    fwrite("\"}", 2, 1, sink->listFp);
 	}
+	sink->numOfMatches++;
+	return 0;
 }
 
-int traverseNode(long thisNode, SearchContext_t* context) {
-	int speculationSucceded = 0;
+/**
+ * Writes the paths, and with withUuid also the uuids, of all leaf nodes as a JSON array in the listName member.
+ **/
+int writeLeafNodesList(long rootNode, char* listFname, char* listName, bool withUuid) {
+	listSink_t sink;
+	localPattern_t local;
 
-	incDepth(thisNode, context);
-	if (compareNodeName(VSSgetName(thisNode), getPathSegment(0, context)) == true) {
-		bool done;
-		speculationSucceded = saveMatchingNode(thisNode, context, &done);
-		if (done == false) {
-			int numOfChildren = VSSgetNumOfChildren(thisNode);
-			char* childPathName = getPathSegment(1, context);
-			for (int i = 0 ; i < numOfChildren ; i++) {
-				if (compareNodeName(VSSgetName(VSSgetChild(thisNode, i)), childPathName) == true) {
-					speculationSucceded += traverseNode(VSSgetChild(thisNode, i), context);
-				}
+	FILE* listFp = fopen(listFname, "w+");
+	if (listFp == NULL) {
+		return -1;
+	}
+	sink.rootNode = rootNode;
+	sink.listFp = listFp;
+	sink.withUuid = withUuid;
+	sink.numOfMatches = 0;
+	fwrite("{\"", 2, 1, listFp);
+	fwrite(listName, strlen(listName), 1, listFp);
+	fwrite("\":[", 3, 1, listFp);
+	int matches = VSSSearchStream(compileLocalPattern(&local, "Vehicle.*"), rootNode, true, true, 0, NULL, writeListEntry, &sink, NULL);  // anyDepth = true, leafNodesOnly = true
+	fwrite("]}", 2, 1, listFp);
+	fclose(listFp);
+	return matches;
+}
+
+int VSSGetLeafNodesList(long rootNode, char* listFname) {
+	return writeLeafNodesList(rootNode, listFname, "leafpaths", false);
+}
+
+int VSSGetUuidList(long rootNode, char* listFname) {
+	return writeLeafNodesList(rootNode, listFname, "leafuuids", true);
+}
+
+void VSSWriteTree(char* filePath, long rootHandle) {
+	node_t* node = (node_t*)((intptr_t)rootHandle);
+	if (node->tree->lazyRecords != NULL) {  // the nodes of a format version 2 tree are an array in pre-order
+		node_t* nodes = node - node->index;
+		for (int i = 0 ; i < node->tree->readTreeMetadata.totalNodes ; i++) {
+			withAttributes((long)((intptr_t)&nodes[i]));
+		}
+	}
+	if (node->tree->attributes != VSS_ATTR_ALL) {  // the file would silently lose the attribute classes that were dropped
+		if (node->tree->quiet == false) {
+			printf("The tree was loaded without all attributes, it is not written\n");
+		}
+		return;
+	}
+	if (fitsFormatV1((node_t*)((intptr_t)rootHandle)) == false) {
+		printf("The tree is not written\n");
+		return;
+	}
+	FILE* treeFp = fopen(filePath, "w");
+	if (treeFp == NULL) {
+		printf("Could not open file for writing tree data\n");
+		return;
+	}
+	if (traverseAndWriteNode(treeFp, (struct node_t*)((intptr_t)rootHandle)) == false) {
+		printf("Could not write tree data\n");
+	}
+	fclose(treeFp);
+}
+
+/**
+ * Fields of a format version 1 record in the order of the file, and the bytes of their length prefixes. The number of children follows the last field.
+ **/
+typedef enum {V1NAME, V1TYPE, V1UUID, V1DESCR, V1DATATYPE, V1MIN, V1MAX, V1UNIT, V1ALLOWED, V1DEFAULT, V1VALIDATE, V1NUMOFFIELDS} v1Field_t;
+static const uint8_t v1LenBytes[V1NUMOFFIELDS] = {1, 1, 1, 2, 1, 1, 1, 1, 2, 1, 1};
+
+/**
+ * A node of VSSParseStream() that has children stays on the stack until they have been left. Its view is built again from its record for the leave callback.
+ **/
+typedef struct streamFrame_t {
+	size_t record;       // offset of the record in the record buffer for format version 1, or in the node section for format version 2
+	uint32_t index;
+	uint32_t remaining;  // children that have not been left yet
+	uint32_t pathLen;    // length of the path of the node
+	uint8_t inheritedValidate;
+} streamFrame_t;
+
+#define STREAMWINDOWSIZE (64*1024)
+
+typedef struct streamParser_t {
+	FILE* fp;
+	int version;
+	char* window;  // the part of the format version 1 file that has been read and not yet parsed is from windowPos to windowLen
+	size_t windowPos;
+	size_t windowLen;
+	uint8_t* map;  // the format version 2 file
+	size_t mapLen;
+	const uint8_t* offsets;
+	const uint8_t* nodeSection;
+	uint32_t nodeSectionSize;
+	uint32_t nodeCount;
+	stringPool_t pool;
+	char* records;  // the format version 1 records of the nodes on the stack, followed by that of the current node
+	size_t recordsLen;
+	size_t recordsSize;
+	char* path;
+	size_t pathSize;
+	streamFrame_t* frames;
+	size_t framesSize;
+	uint32_t depth;
+	vssAllowed_t* allowed;  // the allowed values of the current view
+	size_t allowedSize;
+} streamParser_t;
+
+/**
+ * Returns buf grown to hold at least needed elements of elemSize bytes, or NULL if out of memory, in which case buf is unchanged.
+ **/
+static void* growBuffer(void* buf, size_t* size, size_t needed, size_t elemSize) {
+	if (needed <= *size) {
+		return buf;
+	}
+	size_t grown = *size > 0 ? *size : 64;
+	while (grown < needed) {
+		grown *= 2;
+	}
+	void* mem = realloc(buf, grown*elemSize);
+	if (mem != NULL) {
+		*size = grown;
+	}
+	return mem;
+}
+
+/**
+ * Copies the next len bytes of the file to dst, and refills the window from the file when it is exhausted. Returns false if the file ends before.
+ **/
+static bool readStreamBytes(streamParser_t* parser, char* dst, size_t len) {
+	while (len > 0) {
+		if (parser->windowPos == parser->windowLen) {
+			parser->windowPos = 0;
+			parser->windowLen = fread(parser->window, 1, STREAMWINDOWSIZE, parser->fp);
+			if (parser->windowLen == 0) {
+				return false;
 			}
 		}
+		size_t chunk = parser->windowLen - parser->windowPos < len ? parser->windowLen - parser->windowPos : len;
+		memcpy(dst, &parser->window[parser->windowPos], chunk);
+		parser->windowPos += chunk;
+		dst += chunk;
+		len -= chunk;
 	}
-	decDepth(speculationSucceded, context);
-	return speculationSucceded;
+	return true;
 }
 
-void initContext(SearchContext_t* context, char* searchPath, long rootNode, int maxFound, searchData_t* searchData, bool anyDepth, bool leafNodesOnly, int listSize, noScopeList_t* noScopeList) {
-	context->searchPath = searchPath;
-	/*    if (anyDepth == true && context->searchPath[strlen(context->searchPath)-1] != '*') {
-		  strcat(context->searchPath, ".*");
-		  } */
-	context->rootNode = rootNode;
-	context->maxFound = maxFound;
-	context->searchData = searchData;
-	if (anyDepth == true) {
-		context->maxDepth = 100;  //jan 2020 max tree depth = 8
-	} else {
-		context->maxDepth = countSegments(context->searchPath);
+/**
+ * Appends the next format version 1 record, with its length prefixes, from the file to the record buffer.
+ **/
+static int readRecordV1(streamParser_t* parser) {
+	for (int field = 0 ; field <= V1NUMOFFIELDS ; field++) {
+		size_t lenBytes = field < V1NUMOFFIELDS ? v1LenBytes[field] : sizeof(uint8_t);  // the number of children is read as a prefix without a field
+		uint8_t prefix[2];
+		if (readStreamBytes(parser, (char*)prefix, lenBytes) == false) {
+			return VSS_ERR_TRUNCATED;
+		}
+		uint32_t len = field == V1NUMOFFIELDS ? 0 : lenBytes == sizeof(uint8_t) ? prefix[0] : (uint32_t)(prefix[0] | prefix[1] << 8);
+		char* records = (char*) growBuffer(parser->records, &parser->recordsSize, parser->recordsLen + lenBytes + len, sizeof(char));
+		if (records == NULL) {
+			return VSS_ERR_NOMEM;
+		}
+		parser->records = records;
+		memcpy(&records[parser->recordsLen], prefix, lenBytes);
+		parser->recordsLen += lenBytes;
+		if (readStreamBytes(parser, &records[parser->recordsLen], len) == false) {
+			return VSS_ERR_TRUNCATED;
+		}
+		parser->recordsLen += len;
 	}
-	context->leafNodesOnly = leafNodesOnly;
-	context->listSize = listSize;
- 	context->noScopeList = NULL;
-	if (listSize > 0) {
-  	    context->noScopeList = noScopeList;
+	return VSS_OK;
+}
+
+/**
+ * Builds the view of a format version 1 record that is in the record buffer, except the path and the fields that depend on the stack.
+ **/
+static int decodeViewV1(streamParser_t* parser, size_t record, vssNodeView_t* view) {
+	v1Cursor_t cursor = {&parser->records[record], &parser->records[parser->recordsLen], VSS_OK};
+	const char* fields[V1NUMOFFIELDS];
+	uint32_t lens[V1NUMOFFIELDS];
+	for (int field = 0 ; field < V1NUMOFFIELDS ; field++) {
+		lens[field] = readLenV1(&cursor, v1LenBytes[field]);
+		fields[field] = lens[field] > 0 ? readBytesV1(&cursor, lens[field]) : NULL;
 	}
-	context->maxValidation = 0;
-	context->currentDepth = 0;
-	context->matchPath[0] = 0;
-	context->numOfMatches = 0;
-	context->speculationIndex = -1;
-	for (int i = 0 ; i < 20 ; i++) {
-		context->speculativeMatches[i] = 0;
+	view->children = readLenV1(&cursor, sizeof(uint8_t));
+	if (cursor.status != VSS_OK) {
+		return cursor.status;
+	}
+	char code[UINT8_MAX+1];  // the type and validate strings are converted from a null terminated copy
+	memcpy(code, fields[V1TYPE] != NULL ? fields[V1TYPE] : "", lens[V1TYPE]);
+	code[lens[V1TYPE]] = '\0';
+	view->type = stringToNodeType(code);
+	memcpy(code, fields[V1VALIDATE] != NULL ? fields[V1VALIDATE] : "", lens[V1VALIDATE]);
+	code[lens[V1VALIDATE]] = '\0';
+	view->validate = lens[V1VALIDATE] > 0 ? validateToUint8(code) : 0;
+	view->name = fields[V1NAME];
+	view->nameLen = lens[V1NAME];
+	view->uuid = fields[V1UUID];
+	view->uuidLen = lens[V1UUID];
+	view->description = fields[V1DESCR];
+	view->descrLen = lens[V1DESCR];
+	view->datatype = fields[V1DATATYPE];
+	view->datatypeLen = lens[V1DATATYPE];
+	view->datatypeCode = datatypeToCode(view->datatype, view->datatypeLen);
+	view->min = fields[V1MIN];
+	view->minLen = lens[V1MIN];
+	view->max = fields[V1MAX];
+	view->maxLen = lens[V1MAX];
+	view->unit = fields[V1UNIT];
+	view->unitLen = lens[V1UNIT];
+	view->defaultAllowed = fields[V1DEFAULT];
+	view->defaultLen = lens[V1DEFAULT];
+
+	view->allowed = 0;
+	int elemLen;
+	for (uint32_t index = 0 ; (elemLen = allowedElementLenV1(fields[V1ALLOWED], lens[V1ALLOWED], index)) >= 0 ; index += elemLen + 2) {
+		vssAllowed_t* allowed = (vssAllowed_t*) growBuffer(parser->allowed, &parser->allowedSize, view->allowed + 1, sizeof(vssAllowed_t));
+		if (allowed == NULL) {
+			return VSS_ERR_NOMEM;
+		}
+		parser->allowed = allowed;
+		allowed[view->allowed].value = (char*)&fields[V1ALLOWED][index+2];
+		allowed[view->allowed++].len = (uint32_t)elemLen;
 	}
+	view->allowedDef = view->allowed > 0 ? parser->allowed : NULL;
+	return VSS_OK;
 }
 
-//used for VSSGetLeafNodeList
-void initContext_LNL(SearchContext_t* context, char* searchPath, long rootNode, FILE* listFp, bool anyDepth, bool leafNodesOnly, int listSize, noScopeList_t* noScopeList) {
-	context->searchPath = searchPath;
-	context->rootNode = rootNode;
-	context->maxFound = 0;
-	context->searchData = NULL;
-	context->listFp = listFp;
-	if (anyDepth == true) {
-		context->maxDepth = 100;  //jan 2020 max tree depth = 8
-	} else {
-		context->maxDepth = countSegments(context->searchPath);
+/**
+ * Decodes a string reference of a format version 2 record into a view, where an empty string is NULL.
+ **/
+static inline int decodeViewString(const uint8_t** cursor, const uint8_t* recEnd, stringPool_t* pool, uint32_t base, const char** str, uint32_t* len) {
+	char* poolStr;
+	int status = decodeString(cursor, recEnd, pool, base, &poolStr, len, UINT32_MAX);
+	*str = status == VSS_OK && *len > 0 ? poolStr : NULL;
+	return status;
+}
+
+/**
+ * Builds the view of a format version 2 record like decodeViewV1(), the strings point into the mapped string pool.
+ **/
+static int decodeViewV2(streamParser_t* parser, size_t record, vssNodeView_t* view) {
+	const uint8_t* cursor = &parser->nodeSection[record];
+	const uint8_t* recEnd = &parser->nodeSection[parser->nodeSectionSize];
+	node_t node;
+	int status;
+	if ((status = decodeStructureV2(&node, &cursor, recEnd, &parser->pool)) != VSS_OK) return status;
+	view->name = node.name;
+	view->nameLen = node.nameLen;
+	view->type = node.type;
+	view->datatype = node.datatype;
+	view->datatypeLen = node.datatypeLen;
+	view->datatypeCode = node.datatypeCode;
+	view->validate = node.validate;
+	view->children = node.children;
+	if ((status = decodeViewString(&cursor, recEnd, &parser->pool, 0, &view->uuid, &view->uuidLen)) != VSS_OK) return status;
+	if ((status = decodeViewString(&cursor, recEnd, &parser->pool, parser->pool.descrBase, &view->description, &view->descrLen)) != VSS_OK) return status;
+	if ((status = decodeViewString(&cursor, recEnd, &parser->pool, 0, &view->min, &view->minLen)) != VSS_OK) return status;
+	if ((status = decodeViewString(&cursor, recEnd, &parser->pool, 0, &view->max, &view->maxLen)) != VSS_OK) return status;
+	if ((status = decodeViewString(&cursor, recEnd, &parser->pool, 0, &view->unit, &view->unitLen)) != VSS_OK) return status;
+	if ((status = decodeVarint(&cursor, recEnd, &view->allowed)) != VSS_OK) return status;
+	if (view->allowed > (uint32_t)(recEnd - cursor) / 2) {  // every element reference takes at least two bytes
+		return VSS_ERR_CORRUPT;
 	}
-	context->leafNodesOnly = leafNodesOnly;
-	context->listSize = listSize;
- 	context->noScopeList = NULL;
-	if (listSize > 0) {
-  	    context->noScopeList = noScopeList;
+	view->allowedDef = NULL;
+	if (view->allowed > 0) {
+		vssAllowed_t* allowed = (vssAllowed_t*) growBuffer(parser->allowed, &parser->allowedSize, view->allowed, sizeof(vssAllowed_t));
+		if (allowed == NULL) {
+			return VSS_ERR_NOMEM;
+		}
+		parser->allowed = allowed;
+		for (uint32_t i = 0 ; i < view->allowed ; i++) {
+			if ((status = decodeString(&cursor, recEnd, &parser->pool, 0, &allowed[i].value, &allowed[i].len, UINT32_MAX)) != VSS_OK) return status;
+		}
+		view->allowedDef = allowed;
 	}
-	context->maxValidation = 0;
-	context->currentDepth = 0;
-	context->matchPath[0] = 0;
-	context->numOfMatches = 0;
-	context->speculationIndex = -1;
-	for (int i = 0 ; i < 20 ; i++) {
-		context->speculativeMatches[i] = 0;
+	return decodeViewString(&cursor, recEnd, &parser->pool, 0, &view->defaultAllowed, &view->defaultLen);
+}
+
+/**
+ * Opens the file for VSSParseStream(), a format version 1 file is read through a window of STREAMWINDOWSIZE bytes, and a format version 2 file is mapped.
+ **/
+static int openStream(streamParser_t* parser, char* filePath) {
+	parser->fp = fopen(filePath, "r");
+	if (parser->fp == NULL) {
+		return VSS_ERR_OPEN;
+	}
+	vssFileInfo_t info;
+	int status = readFileInfo(parser->fp, &info);
+	parser->version = info.version;
+	if (status != VSS_OK || info.version == 1) {
+		parser->window = (char*) malloc(STREAMWINDOWSIZE);
+		return status == VSS_OK && parser->window == NULL ? VSS_ERR_NOMEM : status;
+	}
+	size_t indexLen = sizeof(uint32_t)*info.nodeCount + info.nodeSectionSize;
+	parser->mapLen = V2HEADERSIZE + indexLen + info.stringPoolSize;
+	parser->map = (uint8_t*) mmap(NULL, parser->mapLen, PROT_READ, MAP_PRIVATE, fileno(parser->fp), 0);
+	if (parser->map == MAP_FAILED) {
+		parser->map = NULL;
+		return VSS_ERR_NOMEM;
 	}
+	parser->offsets = &parser->map[V2HEADERSIZE];
+	parser->nodeSection = &parser->map[V2HEADERSIZE + sizeof(uint32_t)*info.nodeCount];
+	parser->nodeSectionSize = info.nodeSectionSize;
+	parser->nodeCount = info.nodeCount;
+	parser->pool = (stringPool_t){(char*)&parser->map[V2HEADERSIZE + indexLen], info.stringPoolSize, info.descrPoolOffset, true};
+	return VSS_OK;
 }
 
-long VSSReadTree(char* filePath) {
-	treeFp = fopen(filePath, "r");
-	if (treeFp == NULL) {
-		printf("Could not open file for reading tree data\n");
-		return 0;
+static void closeStream(streamParser_t* parser) {
+	if (parser->map != NULL) {
+		munmap(parser->map, parser->mapLen);
 	}
-	initReadMetadata();
-	intptr_t root = (intptr_t)traverseAndReadNode(NULL);
-	printReadMetadata();
-	fclose(treeFp);
-	return (long)root;
+	if (parser->fp != NULL) {
+		fclose(parser->fp);
+	}
+	free(parser->window);
+	free(parser->records);
+	free(parser->path);
+	free(parser->frames);
+	free(parser->allowed);
 }
 
-int VSSSearchNodes(char* searchPath, long rootNode, int maxFound, searchData_t* searchData, bool anyDepth,  bool leafNodesOnly, int listSize, noScopeList_t* noScopeList, int* validation) {
-	//    intptr_t root = (intptr_t)rootNode;
-	struct SearchContext_t searchContext;
-	struct SearchContext_t* context = &searchContext;
-	isGetLeafNodeList = false;
-	isGetUuidList = false;
+/**
+ * Reads the record of the node with the index, and returns its position for decodeView().
+ **/
+static int nextRecord(streamParser_t* parser, uint32_t index, size_t* record) {
+	if (parser->version == 1) {
+		*record = parser->recordsLen;
+		return readRecordV1(parser);
+	}
+	if (index >= parser->nodeCount) {
+		return VSS_ERR_CORRUPT;
+	}
+	*record = getUint32(&parser->offsets[index*sizeof(uint32_t)]);
+	return *record < parser->nodeSectionSize ? VSS_OK : VSS_ERR_CORRUPT;
+}
 
-	initContext(context, searchPath, rootNode, maxFound, searchData, anyDepth, leafNodesOnly, listSize, noScopeList);
-	traverseNode(rootNode, context);
-	if (validation != NULL) {
-		*validation = context->maxValidation;
+static inline int decodeView(streamParser_t* parser, size_t record, vssNodeView_t* view) {
+	return parser->version == 1 ? decodeViewV1(parser, record, view) : decodeViewV2(parser, record, view);
+}
+
+/**
+ * Appends the name of the node to the path of its parent.
+ **/
+static int appendPath(streamParser_t* parser, vssNodeView_t* view) {
+	uint32_t parentLen = parser->depth > 0 ? parser->frames[parser->depth-1].pathLen : 0;
+	view->pathLen = parentLen + (parentLen > 0 ? 1 : 0) + view->nameLen;
+	char* path = (char*) growBuffer(parser->path, &parser->pathSize, (size_t)view->pathLen + 1, sizeof(char));
+	if (path == NULL) {
+		return VSS_ERR_NOMEM;
 	}
-	return context->numOfMatches;
+	parser->path = path;
+	if (parentLen > 0) {
+		path[parentLen] = '.';
+	}
+	if (view->nameLen > 0) {
+		memcpy(&path[view->pathLen - view->nameLen], view->name, view->nameLen);
+	}
+	path[view->pathLen] = '\0';
+	view->path = path;
+	return VSS_OK;
 }
 
-int VSSGetLeafNodesList(long rootNode, char* listFname) {
-	struct SearchContext_t searchContext;
-	struct SearchContext_t* context = &searchContext;
-	isGetLeafNodeList = true;
+/**
+ * Pops the nodes whose children have all been left, and calls leaveNode with each of them. Returns non-zero if a callback stopped the parse.
+ **/
+static int leaveParents(streamParser_t* parser, vssNodeViewCallback_t leaveNode, void* userData, int* status) {
+	while (parser->depth > 0 && --parser->frames[parser->depth-1].remaining == 0) {
+		streamFrame_t* frame = &parser->frames[--parser->depth];
+		if (leaveNode != NULL) {
+			vssNodeView_t view;
+			if ((*status = decodeView(parser, frame->record, &view)) != VSS_OK) {
+				return 1;
+			}
+			parser->path[frame->pathLen] = '\0';
+			view.path = parser->path;
+			view.pathLen = frame->pathLen;
+			view.inheritedValidate = frame->inheritedValidate;
+			view.depth = parser->depth;
+			view.index = frame->index;
+			if (leaveNode(&view, userData) != 0) {
+				return 1;
+			}
+		}
+		if (parser->version == 1) {
+			parser->recordsLen = frame->record;  // the record is no longer needed
+		}
+	}
+	return 0;
+}
 
-	FILE* listFp = fopen(listFname, "w+");
-	fwrite("{\"leafpaths\":[", 14, 1, listFp);
-	initContext_LNL(context, "Vehicle.*", rootNode, listFp, true, true, 0, NULL);  // anyDepth = true, leafNodesOnly = true
-	traverseNode(rootNode, context);
-	fwrite("]}", 2, 1, listFp);
-	fclose(listFp);
+int VSSParseStream(char* filePath, vssNodeViewCallback_t enterNode, vssNodeViewCallback_t leaveNode, void* userData) {
+	streamParser_t parser;
+	memset(&parser, 0, sizeof(streamParser_t));
+	int status = openStream(&parser, filePath);
+	for (uint32_t index = 0 ; status == VSS_OK ; index++) {
+		size_t record;
+		vssNodeView_t view;
+		if ((status = nextRecord(&parser, index, &record)) != VSS_OK || (status = decodeView(&parser, record, &view)) != VSS_OK || (status = appendPath(&parser, &view)) != VSS_OK) {
+			break;
+		}
+		view.inheritedValidate = getMaxValidation(view.validate, parser.depth > 0 ? parser.frames[parser.depth-1].inheritedValidate : 0);
+		view.depth = parser.depth;
+		view.index = index;
+		if (enterNode != NULL && enterNode(&view, userData) != 0) {
+			break;
+		}
+		if (view.children > 0) {
+			streamFrame_t* frames = (streamFrame_t*) growBuffer(parser.frames, &parser.framesSize, (size_t)parser.depth + 1, sizeof(streamFrame_t));
+			if (frames == NULL) {
+				status = VSS_ERR_NOMEM;
+				break;
+			}
+			parser.frames = frames;
+			frames[parser.depth++] = (streamFrame_t){record, index, view.children, view.pathLen, view.inheritedValidate};
+			continue;
+		}
+		if (leaveNode != NULL && leaveNode(&view, userData) != 0) {
+			break;
+		}
+		if (parser.version == 1) {
+			parser.recordsLen = record;
+		}
+		if (leaveParents(&parser, leaveNode, userData, &status) != 0) {
+			break;
+		}
+		if (parser.depth == 0) {  // the root has been left, so the file must end here
+			char extra;
+			if ((parser.version == 1 && readStreamBytes(&parser, &extra, 1) == true) || (parser.version == 2 && index + 1 != parser.nodeCount)) {
+				status = VSS_ERR_CORRUPT;
+			}
+			break;
+		}
+	}
+	closeStream(&parser);
+	return status;
+}
+
+#define RECLAIMPOLLNS 100000  // interval at which a reload checks whether the readers of the old tree have released it
+#define RELOADREQUEST 'r'
+#define CLOSEREQUEST 'q'
 
-	return context->numOfMatches;
+typedef struct readerCount_t {
+	uint64_t count;
+} __attribute__((aligned(64))) readerCount_t;  // on a cache line of its own, as every acquire and release writes it
+
+/**
+ * The readers of a managed tree are counted per epoch parity. A reload publishes the new tree, then advances the epoch,
+ * and waits until the readers of the epoch that ended are gone before it frees the old tree. The readers of that epoch are the only ones that can hold
+ * the old tree, as those of the epoch before it were waited for by the previous reload, and those of the new epoch read the root after the swap.
+ **/
+struct vssManagedTree_t {
+	readerCount_t readers[2];
+	long root;
+	uint64_t epoch;
+	char* filePath;
+	char* fileName;  // the name of the file within its directory, which is watched
+	int loadFlags;
+	int attributes;
+	pthread_mutex_t reloadLock;  // serializes the reloads, the readers never take it
+	int reloadStatus;      // written under reloadLock, read without it
+	uint64_t generation;   // written under reloadLock, read without it
+	pthread_t thread;
+	bool threadStarted;
+	int wakeFds[2];  // pipe that passes RELOADREQUEST and CLOSEREQUEST to the thread
+	int watchFd;     // inotify instance if the file is watched, else -1
+};
+
+long VSSAcquireTree(vssManagedTree_t* managed, int* ticket) {
+	for (;;) {  // retries only if a reload advanced the epoch in between
+		uint64_t epoch = __atomic_load_n(&managed->epoch, __ATOMIC_SEQ_CST);
+		__atomic_fetch_add(&managed->readers[epoch & 1].count, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&managed->epoch, __ATOMIC_SEQ_CST) == epoch) {
+			*ticket = (int)(epoch & 1);
+			return __atomic_load_n(&managed->root, __ATOMIC_SEQ_CST);
+		}
+		__atomic_fetch_sub(&managed->readers[epoch & 1].count, 1, __ATOMIC_SEQ_CST);
+	}
 }
 
-int VSSGetUuidList(long rootNode, char* listFname) {
-	struct SearchContext_t searchContext;
-	struct SearchContext_t* context = &searchContext;
-	isGetUuidList = true;
+void VSSReleaseTree(vssManagedTree_t* managed, int ticket) {
+	__atomic_fetch_sub(&managed->readers[ticket & 1].count, 1, __ATOMIC_RELEASE);
+}
 
-	FILE* listFp = fopen(listFname, "w+");
-	fwrite("{\"leafuuids\":[", 14, 1, listFp);
-	initContext_LNL(context, "Vehicle.*", rootNode, listFp, true, true, 0, NULL);  // anyDepth = true, leafNodesOnly = true
-	traverseNode(rootNode, context);
-	//    int len = strlen(leafNodeList);
-	//    leafNodeList[len-2] = '\0';
-	fwrite("]}", 2, 1, listFp);
-	fclose(listFp);
+static int reloadTree(vssManagedTree_t* managed) {
+	pthread_mutex_lock(&managed->reloadLock);
+	int status;
+	long root = VSSLoadTreeAttributes(managed->filePath, managed->loadFlags, managed->attributes, &status);
+	if (root != 0) {
+		long retiredRoot = __atomic_exchange_n(&managed->root, root, __ATOMIC_SEQ_CST);
+		uint64_t retiredEpoch = __atomic_fetch_add(&managed->epoch, 1, __ATOMIC_SEQ_CST);
+		struct timespec interval = {0, RECLAIMPOLLNS};
+		while (__atomic_load_n(&managed->readers[retiredEpoch & 1].count, __ATOMIC_ACQUIRE) != 0) {
+			nanosleep(&interval, NULL);
+		}
+		VSSFreeTree(retiredRoot);
+		__atomic_fetch_add(&managed->generation, 1, __ATOMIC_RELEASE);
+	}
+	__atomic_store_n(&managed->reloadStatus, status, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&managed->reloadLock);
+	return status;
+}
 
-	return context->numOfMatches;
+/**
+ * Reads the pending events of the watched directory, and returns true if the file was written or renamed over.
+ **/
+static bool fileChanged(vssManagedTree_t* managed) {
+	bool changed = false;
+#ifdef __linux__
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len = read(managed->watchFd, events, sizeof(events));
+	for (ssize_t pos = 0 ; pos + (ssize_t)sizeof(struct inotify_event) <= len ; ) {
+		struct inotify_event* event = (struct inotify_event*)&events[pos];
+		if (event->len > 0 && strcmp(event->name, managed->fileName) == 0) {
+			changed = true;
+		}
+		pos += sizeof(struct inotify_event) + event->len;
+	}
+#endif
+	return changed;
 }
 
-void VSSWriteTree(char* filePath, long rootHandle) {
-	treeFp = fopen(filePath, "w");
-	if (treeFp == NULL) {
-		printf("Could not open file for writing tree data\n");
-		return;
+static void* reloadThread(void* arg) {
+	vssManagedTree_t* managed = (vssManagedTree_t*)arg;
+	struct pollfd fds[2] = {{managed->wakeFds[0], POLLIN, 0}, {managed->watchFd, POLLIN, 0}};
+	for (;;) {
+		if (poll(fds, managed->watchFd >= 0 ? 2 : 1, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		bool reload = false;
+		if ((fds[0].revents & (POLLIN | POLLHUP)) != 0) {
+			char requests[64];
+			ssize_t len = read(managed->wakeFds[0], requests, sizeof(requests));
+			if (len <= 0 || memchr(requests, CLOSEREQUEST, len) != NULL) {
+				break;
+			}
+			reload = true;
+		}
+		if (managed->watchFd >= 0 && (fds[1].revents & POLLIN) != 0 && fileChanged(managed) == true) {
+			reload = true;
+		}
+		if (reload == true) {
+			reloadTree(managed);
+		}
+	}
+	return NULL;
+}
+
+static void freeManagedTree(vssManagedTree_t* managed) {
+	if (managed->threadStarted == true) {
+		char request = CLOSEREQUEST;
+		if (write(managed->wakeFds[1], &request, 1) == 1) {
+			pthread_join(managed->thread, NULL);
+		}
+	}
+	for (int i = 0 ; i < 2 ; i++) {
+		if (managed->wakeFds[i] >= 0) {
+			close(managed->wakeFds[i]);
+		}
+	}
+	if (managed->watchFd >= 0) {
+		close(managed->watchFd);
+	}
+	VSSFreeTree(managed->root);
+	pthread_mutex_destroy(&managed->reloadLock);
+	free(managed->filePath);
+	free(managed);
+}
+
+/**
+ * Watches the directory of the file, as a new version of the file is usually written to a temporary file that is renamed over it.
+ **/
+static int watchFile(vssManagedTree_t* managed) {
+#ifdef __linux__
+	managed->watchFd = inotify_init1(IN_CLOEXEC);
+	if (managed->watchFd < 0) {
+		return VSS_ERR_OPEN;
+	}
+	char* nameDelim = strrchr(managed->filePath, '/');
+	managed->fileName = nameDelim != NULL ? nameDelim + 1 : managed->filePath;
+	if (nameDelim != NULL) {
+		*nameDelim = '\0';
+	}
+	int watch = inotify_add_watch(managed->watchFd, nameDelim == NULL ? "." : nameDelim == managed->filePath ? "/" : managed->filePath, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (nameDelim != NULL) {
+		*nameDelim = '/';
+	}
+	return watch >= 0 ? VSS_OK : VSS_ERR_OPEN;
+#else
+	(void)managed;
+	return VSS_ERR_OPEN;
+#endif
+}
+
+vssManagedTree_t* VSSOpenManagedTree(char* filePath, int loadFlags, int attributes, bool watch, int* status) {
+	int openStatus;
+	if (status == NULL) {
+		status = &openStatus;
+	}
+	vssManagedTree_t* managed = (vssManagedTree_t*) aligned_alloc(__alignof__(vssManagedTree_t), sizeof(vssManagedTree_t));
+	if (managed == NULL) {
+		*status = VSS_ERR_NOMEM;
+		return NULL;
+	}
+	memset(managed, 0, sizeof(vssManagedTree_t));
+	managed->wakeFds[0] = managed->wakeFds[1] = managed->watchFd = -1;
+	managed->loadFlags = loadFlags;
+	managed->attributes = attributes;
+	managed->generation = 1;
+	pthread_mutex_init(&managed->reloadLock, NULL);
+	managed->filePath = strdup(filePath);
+	if (managed->filePath == NULL) {
+		*status = VSS_ERR_NOMEM;
+	} else {
+		managed->root = VSSLoadTreeAttributes(filePath, loadFlags, attributes, status);
+	}
+	if (*status == VSS_OK && pipe(managed->wakeFds) != 0) {
+		*status = VSS_ERR_OPEN;
+	}
+	if (*status == VSS_OK && watch == true) {
+		*status = watchFile(managed);
+	}
+	if (*status == VSS_OK) {
+		managed->threadStarted = pthread_create(&managed->thread, NULL, reloadThread, managed) == 0;
+		*status = managed->threadStarted == true ? VSS_OK : VSS_ERR_NOMEM;
+	}
+	if (*status != VSS_OK) {
+		freeManagedTree(managed);
+		return NULL;
+	}
+	return managed;
+}
+
+int VSSReloadManagedTree(vssManagedTree_t* managed, bool wait) {
+	if (wait == true) {
+		return reloadTree(managed);
+	}
+	char request = RELOADREQUEST;
+	return write(managed->wakeFds[1], &request, 1) == 1 ? VSS_OK : VSS_ERR_OPEN;
+}
+
+int VSSGetReloadStatus(vssManagedTree_t* managed, uint64_t* generation) {
+	if (generation != NULL) {
+		*generation = __atomic_load_n(&managed->generation, __ATOMIC_ACQUIRE);
+	}
+	return __atomic_load_n(&managed->reloadStatus, __ATOMIC_ACQUIRE);
+}
+
+void VSSCloseManagedTree(vssManagedTree_t* managed) {
+	if (managed != NULL) {
+		freeManagedTree(managed);
 	}
-	traverseAndWriteNode((struct node_t*)((intptr_t)rootHandle));
-	fclose(treeFp);
 }
 
 
@@ -720,36 +3447,111 @@ char* VSSgetDatatype(long nodeHandle) {
 	return NULL;
 }
 
+vssDatatype_t VSSgetDatatypeCode(long nodeHandle) {
+	nodeTypes_t type = VSSgetType(nodeHandle);
+	if (type == BRANCH || type == STRUCT)
+		return VSS_DATATYPE_NONE;
+	return (vssDatatype_t)(((node_t*)((intptr_t)nodeHandle))->datatypeCode & ~VSS_DATATYPE_ARRAY);
+}
+
+bool VSSgetDatatypeIsArray(long nodeHandle) {
+	nodeTypes_t type = VSSgetType(nodeHandle);
+	if (type == BRANCH || type == STRUCT)
+		return false;
+	return (((node_t*)((intptr_t)nodeHandle))->datatypeCode & VSS_DATATYPE_ARRAY) != 0;
+}
+
+const vssRange_t* VSSgetRange(long nodeHandle) {
+	return withAttributes(nodeHandle)->range;
+}
+
+/**
+ * The comparisons are negated so that a NaN fails both.
+ **/
+static inline uint8_t checkBounds(double value, double lowerBound, double upperBound) {
+	return (uint8_t)((!(value >= lowerBound) ? VSS_BELOW_MIN : 0) | (!(value <= upperBound) ? VSS_ABOVE_MAX : 0));
+}
+
+int VSSCheckRange(long nodeHandle, double value) {
+	vssRange_t* range = withAttributes(nodeHandle)->range;
+	return checkBounds(value, range != NULL ? range->lowerBound : -HUGE_VAL, range != NULL ? range->upperBound : HUGE_VAL);
+}
+
+/**
+ * The bounds of a chunk of nodes are gathered first, as the nodes are scattered in memory, and then checked in a branch free loop over contiguous arrays.
+ **/
+#define RANGEBATCHCHUNK 256
+
+int VSSCheckRangeBatch(long* nodeHandles, double* values, int count, uint8_t* results) {
+	double lowerBounds[RANGEBATCHCHUNK];
+	double upperBounds[RANGEBATCHCHUNK];
+	int outOfRange = 0;
+	for (int start = 0 ; start < count ; start += RANGEBATCHCHUNK) {
+		int chunkLen = count - start < RANGEBATCHCHUNK ? count - start : RANGEBATCHCHUNK;
+		for (int i = 0 ; i < chunkLen ; i++) {
+			vssRange_t* range = withAttributes(nodeHandles[start+i])->range;
+			lowerBounds[i] = range != NULL ? range->lowerBound : -HUGE_VAL;
+			upperBounds[i] = range != NULL ? range->upperBound : HUGE_VAL;
+		}
+		for (int i = 0 ; i < chunkLen ; i++) {
+			uint8_t result = checkBounds(values[start+i], lowerBounds[i], upperBounds[i]);
+			results[start+i] = result;
+			outOfRange += result != VSS_IN_RANGE;
+		}
+	}
+	return outOfRange;
+}
+
 char* VSSgetName(long nodeHandle) {
 	return ((node_t*)((intptr_t)nodeHandle))->name;
 }
 
 char* VSSgetUUID(long nodeHandle) {
-	return ((node_t*)((intptr_t)nodeHandle))->uuid;
+	return withAttributes(nodeHandle)->uuid;
 }
 
 int VSSgetValidation(long nodeHandle) {
 	return (int)((intptr_t)((node_t*)((intptr_t)nodeHandle))->validate);
 }
 
+int VSSgetInheritedValidation(long nodeHandle) {
+	return (int)((node_t*)((intptr_t)nodeHandle))->inheritedValidate;
+}
+
+int VSSGetResultValidation(searchData_t* searchData, int numOfMatches) {
+	uint8_t validation = 0;
+	for (int i = 0 ; i < numOfMatches ; i++) {
+		validation = getMaxValidation(VSSgetInheritedValidation(searchData[i].foundNodeHandles), validation);
+	}
+	return validation;
+}
+
 char* VSSgetDescr(long nodeHandle) {
-	return ((node_t*)((intptr_t)nodeHandle))->description;
+	return withAttributes(nodeHandle)->description;
 }
 
 int VSSgetNumOfAllowedElements(long nodeHandle) {
 	nodeTypes_t type = VSSgetType(nodeHandle);
 	if (type != BRANCH && type != STRUCT)
-		return (int)(((node_t*)((intptr_t)nodeHandle))->allowed);
+		return (int)(withAttributes(nodeHandle)->allowed);
 	return 0;
 }
 
 char* VSSgetAllowedElement(long nodeHandle, int index) {
-	return (char*)(((node_t*)((intptr_t)nodeHandle))->allowedDef[index]);
+	node_t* node = withAttributes(nodeHandle);
+	if (index < 0 || (uint32_t)index >= node->allowed) {
+		return NULL;
+	}
+	return node->allowedDef[index].value;
+}
+
+int VSSgetAllowedOrdinal(long nodeHandle, const char* value) {
+	return findAllowed(withAttributes(nodeHandle), value, (uint32_t)strlen(value));
 }
 
 char* VSSgetUnit(long nodeHandle) {
 	nodeTypes_t type = VSSgetType(nodeHandle);
 	if (type != BRANCH && type != STRUCT)
-		return ((node_t*)((intptr_t)nodeHandle))->unit;
+		return withAttributes(nodeHandle)->unit;
 	return NULL;
 }
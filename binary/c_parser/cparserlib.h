@@ -9,42 +9,158 @@
 * Parser library for a  C binary format VSS tree.
 **/
 
+#include "../binaryformat.h"
+
 #define UNKNOWN 0
+
+typedef enum {VSS_OK=0, VSS_ERR_OPEN, VSS_ERR_FORMAT, VSS_ERR_VERSION, VSS_ERR_ENDIANNESS, VSS_ERR_TRUNCATED, VSS_ERR_CORRUPT, VSS_ERR_NOMEM, VSS_ERR_LIMIT} vssStatus_t;
+
+// flags of VSSLoadTree(), VSS_LOAD_MMAP maps a format version 2 file instead of reading it, format version 1 files are always read,
+// VSS_LOAD_COMPACT also builds the compact tree, VSS_LOAD_PATHINDEX also builds the path hash index of VSSLookupPath()
+// VSS_LOAD_LAZY decodes the attributes of a format version 2 node that are not needed for the tree structure and searches on the first call of a getter of one of them
+// VSS_LOAD_QUIET loads without printing the node count and depth, or the reason of a failure, which the status and VSSGetTreeStats() give
+typedef enum {VSS_LOAD_DEFAULT=0, VSS_LOAD_MMAP=1, VSS_LOAD_COMPACT=2, VSS_LOAD_PATHINDEX=4, VSS_LOAD_LAZY=8, VSS_LOAD_QUIET=16} vssLoadFlags_t;
+
+// attribute classes kept by VSSLoadTreeAttributes(), VSS_ATTR_RANGE is the min, max and default, the getters of a class that is not kept return NULL or 0
+typedef enum {VSS_ATTR_UUID=1, VSS_ATTR_DESCR=2, VSS_ATTR_UNIT=4, VSS_ATTR_RANGE=8, VSS_ATTR_ALLOWED=16, VSS_ATTR_ALL=31} vssAttributes_t;
+#define VSS_NUMOFATTRCLASSES 5
+
+/**
+* The bytes of the attributes of all nodes per class, indexed by the bit number of the class in vssAttributes_t, of the classes that
+* are kept and of those that are dropped at load. A string counts its length plus terminator, and an allowed value also its vssAllowed_t,
+* before strings that are equal are shared, so the dropped bytes are an upper bound of the memory saved.
+**/
+typedef struct vssAttributeBytes_t {
+    uint64_t kept[VSS_NUMOFATTRCLASSES];
+    uint64_t dropped[VSS_NUMOFATTRCLASSES];
+} vssAttributeBytes_t;
+
+typedef struct vssFileInfo_t {
+    uint8_t version;  // 1 for the original format, which has no header, so the other members are then zero
+    uint8_t endianness;
+    uint32_t nodeCount;
+    uint32_t maxDepth;
+    uint32_t stringPoolSize;
+    uint32_t nodeSectionSize;
+    uint32_t descrPoolOffset;  // start of the descriptions in the string pool
+} vssFileInfo_t;
 typedef enum {SENSOR=1, ACTUATOR, ATTRIBUTE, BRANCH, STRUCT, PROPERTY } nodeTypes_t;
+#define VSS_NUMOFNODETYPES (PROPERTY+1)
+
+/**
+* Statistics of a loaded tree. nodesPerType is indexed by nodeTypes_t, where UNKNOWN counts the nodes with a type that is not known.
+* The allocations are the memory owned by the tree, the tree itself and the slabs of its arena, which grow when the attributes of
+* a VSS_LOAD_LAZY tree are decoded. stringPoolBytes is the string pool that is read or mapped for a format version 2 file, and the
+* strings that are stored once for a format version 1 file. loadNs is the wall time of the load, including the optional indexes.
+**/
+typedef struct vssTreeStats_t {
+    uint32_t totalNodes;
+    uint32_t nodesPerType[VSS_NUMOFNODETYPES];
+    uint32_t maxDepth;
+    uint64_t bytesRead;  // bytes of the file that are read, or mapped with VSS_LOAD_MMAP
+    uint64_t allocations;
+    uint64_t allocatedBytes;
+    uint64_t stringPoolBytes;
+    uint64_t loadNs;
+} vssTreeStats_t;
 
-#define MAXALLOWEDELEMENTLEN 64
-typedef char allowed_t[MAXALLOWEDELEMENTLEN];
+// base datatype of a node, VSS_DATATYPE_STRUCT is any datatype that is not a primitive type, e.g. a struct defined in the tree
+typedef enum {VSS_DATATYPE_NONE=0, VSS_DATATYPE_INT8, VSS_DATATYPE_UINT8, VSS_DATATYPE_INT16, VSS_DATATYPE_UINT16, VSS_DATATYPE_INT32, VSS_DATATYPE_UINT32,
+              VSS_DATATYPE_INT64, VSS_DATATYPE_UINT64, VSS_DATATYPE_BOOLEAN, VSS_DATATYPE_FLOAT, VSS_DATATYPE_DOUBLE, VSS_DATATYPE_STRING, VSS_DATATYPE_STRUCT} vssDatatype_t;
+#define VSS_DATATYPE_ARRAY 0x80  // flag of the datatype code of a node, set if the datatype is an array of the base datatype
+
+// validate of a node is the access restriction plus VSS_VALIDATE_CONSENT if consent is also required
+typedef enum {VSS_VALIDATE_NONE=0, VSS_VALIDATE_WRITE_ONLY=1, VSS_VALIDATE_READ_WRITE=2, VSS_VALIDATE_CONSENT=10} vssValidate_t;
+
+// a value in the representation of the base datatype of its node: i for the signed integer types, u for the unsigned integer types and boolean,
+// and f for float and double
+typedef union vssValue_t {
+    int64_t i;
+    uint64_t u;
+    double f;
+} vssValue_t;
+
+#define VSS_HAS_MIN 1
+#define VSS_HAS_MAX 2
+#define VSS_HAS_DEFAULT 4
+
+// min, max and default of a node with a numeric or boolean datatype, parsed at load, flags tells which of them are given
+typedef struct vssRange_t {
+    vssValue_t min;
+    vssValue_t max;
+    vssValue_t defaultValue;
+    double lowerBound;  // min as double, or -HUGE_VAL if there is no min, for the range checks
+    double upperBound;  // max as double, or HUGE_VAL if there is no max
+    uint8_t flags;
+} vssRange_t;
+
+// result of a range check, a NaN is never in range
+typedef enum {VSS_IN_RANGE=0, VSS_BELOW_MIN=1, VSS_ABOVE_MAX=2, VSS_NOT_A_NUMBER=3} vssRangeResult_t;
+
+// an allowed value of a node, the null terminated value is shared with the nodes that have the same value
+typedef struct vssAllowed_t {
+    char* value;
+    uint32_t len;
+} vssAllowed_t;
 
 typedef struct node_t {
-    uint16_t nameLen;
+    uint32_t nameLen;
     char* name;
     nodeTypes_t type;
-    uint8_t uuidLen;
+    uint32_t uuidLen;
     char* uuid;
-    uint16_t descrLen;
+    uint32_t descrLen;
     char* description;
-    uint8_t datatypeLen;
+    uint32_t datatypeLen;
     char* datatype;
-    uint8_t maxLen;
+    uint32_t maxLen;
     char* max;
-    uint8_t minLen;
+    uint32_t minLen;
     char* min;
-    uint8_t unitLen;
+    uint32_t unitLen;
     char* unit;
-    uint8_t allowed;
-    allowed_t *allowedDef;
-    uint8_t defaultLen;
+    uint32_t allowed;
+    vssAllowed_t* allowedDef;  // in the order of the file, which gives the ordinal of each value
+    vssAllowed_t** allowedSorted;  // the allowed values ordered by length and value if there are many, else NULL
+    uint32_t defaultLen;
     char* defaultAllowed;
+    vssRange_t* range;  // NULL if the node has no min, max or default that is a value of its datatype
     uint8_t validate;
-    uint8_t children;
+    uint8_t inheritedValidate;  // validate of the node combined with those of all its ancestors, set at load
+    uint8_t datatypeCode;  // vssDatatype_t of the datatype, with VSS_DATATYPE_ARRAY set if it is an array
+    uint32_t children;
     struct node_t* parent;
     struct node_t** child;
+    struct node_t** sortedChild;  // the children ordered by name length and name if there are many, else NULL, child keeps the file order
+    struct vssTree_t* tree;  // the tree that owns the memory of the node
+    uint32_t index;  // pre-order position of the node in the tree, the root has index 0
+    uint32_t lazyAttributes;  // position of the attributes that are not decoded yet in the records of a VSS_LOAD_LAZY tree, else 0
 } node_t;
 
+#define VSSNOINDEX UINT32_MAX
+
+/**
+* Compact struct-of-arrays layout of a tree, where a node is the 32-bit index of its pre-order position, which is the
+* same for every load of the same file. The first child of node i, if any, is i+1, and the nodes of the subtree of i are
+* the indices i to subtreeEnd[i]-1, so the next sibling of child c is subtreeEnd[c] if it is below subtreeEnd[parent[c]].
+**/
+typedef struct vssCompactTree_t {
+    uint32_t nodeCount;
+    uint32_t* parent;      // VSSNOINDEX for the root
+    uint32_t* subtreeEnd;
+    uint32_t* childCount;
+    uint32_t* nameOffset;  // offset of the null terminated name in names
+    uint8_t* type;         // nodeTypes_t
+    uint8_t* validate;
+    uint8_t* inheritedValidate;
+    char* names;           // the node names in pre-order
+    long* handles;         // node handle of each index, for the attributes that are not in the compact tree
+} vssCompactTree_t;
+
 #define MAXCHARSPATH 512
 typedef char path_t[MAXCHARSPATH];
 
-#define MAXFOUNDNODES 1500   //may need to be revised when tree size grows
+#define MAXFOUNDNODES 1500   // not a limit of the library, searches write at most maxFound entries
 typedef struct searchData_t {
     path_t responsePaths;
     long foundNodeHandles;
@@ -54,23 +170,221 @@ typedef struct noScopeList_t {
     path_t path;
 } noScopeList_t;
 
+/**
+* A search path compiled into its segments, so that a search does not rescan the path string for every visited node.
+* Searches do not modify a compiled pattern, so it can be cached, e.g. per subscription, and shared by concurrent searches.
+**/
+typedef struct vssPatternSegment_t {
+    const char* name;  // not null terminated, points into the path of the pattern
+    uint32_t len;
+    bool wildcard;     // the segment is "*"
+} vssPatternSegment_t;
+
+typedef struct vssPattern_t {
+    int numOfSegments;
+    bool trailingWildcard;  // the last segment is "*", which in an anyDepth search also matches the nodes below it
+    vssPatternSegment_t* segments;
+    char* path;
+} vssPattern_t;
+
 long VSSReadTree(char* filePath);
+long VSSLoadTree(char* filePath, int loadFlags, int* status);
+
+/**
+* VSSLoadTreeAttributes() loads the tree with only the attribute classes given by the vssAttributes_t mask, the fields of the other classes
+* are skipped in the file without being stored. VSSLoadTree() keeps VSS_ATTR_ALL. VSSGetAttributeBytes() returns the accounting of the load,
+* where the attributes of a VSS_LOAD_LAZY tree are counted when they are decoded. VSSWriteTree() does not write a tree that was loaded
+* without all classes, as the file would lose them.
+**/
+long VSSLoadTreeAttributes(char* filePath, int loadFlags, int attributes, int* status);
+void VSSGetAttributeBytes(long rootHandle, vssAttributeBytes_t* bytes);
+void VSSGetTreeStats(long rootHandle, vssTreeStats_t* stats);
+void VSSFreeTree(long rootHandle);
+vssCompactTree_t* VSSGetCompactTree(long rootHandle);
+int VSSGetFileInfo(char* filePath, vssFileInfo_t* info);
+char* VSSGetStatusText(int status);
+
+/**
+* Decodes the unsigned LEB128 varint of the format version 2 lengths, counts and offsets at cursor, which must end before end,
+* and moves cursor past it. Returns VSS_OK, or VSS_ERR_CORRUPT if the varint is cut off by end or does not fit in 32 bits.
+**/
+int VSSDecodeVarint(const uint8_t** cursor, const uint8_t* end, uint32_t* value);
 void VSSWriteTree(char* filePath, long rootHandle);
+
+/**
+* A node as passed to the callbacks of VSSParseStream(). The strings are borrowed from the parser and are only valid during the callback,
+* they are not necessarily null terminated, except the path, and an empty field has length 0 and is NULL. The path is the names from the
+* root separated by dots. depth is 0 for the root, and index is the pre-order position of the node, as in a loaded tree.
+**/
+typedef struct vssNodeView_t {
+    const char* name;
+    uint32_t nameLen;
+    const char* path;
+    uint32_t pathLen;
+    nodeTypes_t type;
+    const char* uuid;
+    uint32_t uuidLen;
+    const char* description;
+    uint32_t descrLen;
+    const char* datatype;
+    uint32_t datatypeLen;
+    uint8_t datatypeCode;
+    const char* min;
+    uint32_t minLen;
+    const char* max;
+    uint32_t maxLen;
+    const char* unit;
+    uint32_t unitLen;
+    uint32_t allowed;
+    const vssAllowed_t* allowedDef;  // in the order of the file, the values are views like the other strings
+    const char* defaultAllowed;
+    uint32_t defaultLen;
+    uint8_t validate;
+    uint8_t inheritedValidate;
+    uint32_t children;
+    uint32_t depth;
+    uint32_t index;
+} vssNodeView_t;
+
+/**
+* Called by VSSParseStream() when a node is entered and when it is left, returns 0 to continue the parse or non-zero to stop it.
+**/
+typedef int (*vssNodeViewCallback_t)(const vssNodeView_t* node, void* userData);
+
+/**
+* VSSParseStream() parses the file in one pass without building a tree. enterNode is called with each node in pre-order,
+* and leaveNode with each node after all its children were left, either callback may be NULL. The parser only keeps the records
+* of the ancestors of the current node, so its memory is bounded by the depth of the tree and not by the size of the file.
+* A format version 2 file is mapped, so its pages can be reclaimed. Returns VSS_OK if the whole file was parsed or a callback stopped it,
+* else the status of the failure, which can come after some nodes were passed to the callbacks.
+**/
+int VSSParseStream(char* filePath, vssNodeViewCallback_t enterNode, vssNodeViewCallback_t leaveNode, void* userData);
+
+/**
+* Managed tree for a server that replaces the tree file while it searches the tree. VSSOpenManagedTree() loads the file with the load flags
+* and attributes of VSSLoadTreeAttributes(), and starts a thread that loads the file again on VSSReloadManagedTree(), or when the file is
+* written or renamed over if watch is true. A new tree is published with an atomic pointer swap, and the old tree is freed once the readers
+* that acquired it have released it. A reader calls VSSAcquireTree(), which never blocks, uses the returned root handle for any number of
+* searches, lookups and getters, and calls VSSReleaseTree() with the ticket. A reader should not hold a tree for long, as the reload waits for it,
+* and must not call VSSReloadManagedTree() with wait true or VSSCloseManagedTree() while it holds one.
+* A file that fails to load leaves the current tree in place, VSSGetReloadStatus() returns the status of the last reload, and sets generation
+* to the number of trees published, which is 1 after the open. VSSCloseManagedTree() stops the thread and frees the tree, there must be no readers left.
+**/
+typedef struct vssManagedTree_t vssManagedTree_t;
+
+vssManagedTree_t* VSSOpenManagedTree(char* filePath, int loadFlags, int attributes, bool watch, int* status);
+long VSSAcquireTree(vssManagedTree_t* managed, int* ticket);
+void VSSReleaseTree(vssManagedTree_t* managed, int ticket);
+
+/**
+* Loads the file again in the thread of the managed tree and returns VSS_OK, or in the calling thread if wait is true and returns the status of the load.
+**/
+int VSSReloadManagedTree(vssManagedTree_t* managed, bool wait);
+int VSSGetReloadStatus(vssManagedTree_t* managed, uint64_t* generation);
+void VSSCloseManagedTree(vssManagedTree_t* managed);
+
+/**
+* VSSSearchNodes() writes at most maxFound entries to searchData, and returns the number of entries written, or -1 if out of memory.
+* VSSSearchStream() gives the number of matches when it can be larger than maxFound.
+**/
 int VSSSearchNodes(char* searchPath, long rootNode, int maxFound, searchData_t* searchData, bool anyDepth,  bool leafNodesOnly, int listSize, noScopeList_t* noScopeList, int* validation);
+
+/**
+* VSSCompilePattern() returns the compiled searchPath, or NULL if searchPath is empty or out of memory. It is freed by VSSFreePattern().
+* VSSSearchPattern() is VSSSearchNodes() with a compiled pattern.
+**/
+vssPattern_t* VSSCompilePattern(char* searchPath);
+void VSSFreePattern(vssPattern_t* pattern);
+int VSSSearchPattern(vssPattern_t* pattern, long rootNode, int maxFound, searchData_t* searchData, bool anyDepth,  bool leafNodesOnly, int listSize, noScopeList_t* noScopeList, int* validation);
+
+/**
+* Called by VSSSearchStream() with each match in pre-order, returns 0 to continue the search or non-zero to stop it.
+**/
+typedef int (*vssMatchCallback_t)(long nodeHandle, void* userData);
+
+/**
+* VSSSearchStream() passes the matches to the callback as they are found, without a limit on their number and without building their paths.
+* Returns the number of matches passed to the callback, or -1 if out of memory. VSSGetPath() writes the path of a node from rootNode,
+* or from the root of the tree if rootNode is not above it, to buf and returns its length, or -1 if it does not fit in bufSize.
+**/
+int VSSSearchStream(vssPattern_t* pattern, long rootNode, bool anyDepth, bool leafNodesOnly, int listSize, noScopeList_t* noScopeList, vssMatchCallback_t callback, void* userData, int* validation);
+int VSSGetPath(long nodeHandle, long rootNode, char* buf, int bufSize);
 int VSSGetLeafNodesList(long rootNode, char* listFname);
+
+/**
+* Returns the handle of the node with the full path, e.g. "Vehicle.Cabin.Door.Row1.DriverSide.IsOpen", or 0 if there is none.
+* Wildcards are not expanded. If caseInsensitive is true ASCII letters match in either case, and if more than one node matches
+* the first one in pre-order is returned. The lookup is a hash probe if the tree was loaded with VSS_LOAD_PATHINDEX, else a
+* walk along the path from the root.
+**/
+long VSSLookupPath(long rootHandle, const char* path, bool caseInsensitive);
 int VSSGetUuidList(long rootNode, char* listFname);
 
+/**
+* Searches the compact tree for the nodes whose path matches searchPath, where a '*' segment matches any name, and a final
+* '*' matches the whole subtree if anyDepth is true. Ancestors of the matches are not included, unlike in VSSSearchNodes().
+* Writes at most maxFound node indices in pre-order to found, and returns the number of matches, or -1 if out of memory.
+**/
+int VSSCompactSearch(vssCompactTree_t* compact, char* searchPath, bool anyDepth, bool leafNodesOnly, uint32_t* found, int maxFound);
+int VSSCompactSearchPattern(vssCompactTree_t* compact, vssPattern_t* pattern, bool anyDepth, bool leafNodesOnly, uint32_t* found, int maxFound);
+
+/**
+* A batch compiles many search paths into one trie over their segments, which VSSSearchBatch() matches against the tree in one traversal.
+* The matches of each path are the same, and in the same pre-order, as those of VSSCompactSearch(), and are passed to the callback with
+* the number of the path in searchPaths. The callback returns 0 to continue the search or non-zero to stop it. VSSSearchBatch() returns
+* the number of matches of all paths, or -1 if out of memory. VSSCompileBatch() returns NULL if out of memory, empty paths never match.
+**/
+typedef struct vssBatch_t vssBatch_t;
+typedef int (*vssBatchCallback_t)(int pathNo, long nodeHandle, void* userData);
+
+vssBatch_t* VSSCompileBatch(char** searchPaths, int numOfPaths);
+void VSSFreeBatch(vssBatch_t* batch);
+int VSSSearchBatch(vssBatch_t* batch, long rootNode, bool anyDepth, bool leafNodesOnly, vssBatchCallback_t callback, void* userData);
+
+uint32_t VSSgetIndex(long nodeHandle);
 long VSSgetParent(long nodeHandle);
 long VSSgetChild(long nodeHandle, int childNo);
 int VSSgetNumOfChildren(long nodeHandle);
 nodeTypes_t VSSgetType(long nodeHandle);
 char* VSSgetDatatype(long nodeHandle);
+
+/**
+* VSSgetDatatypeCode() returns the base datatype of the node, which is VSS_DATATYPE_NONE for branches and structs, and VSSgetDatatypeIsArray()
+* whether the datatype is an array of it, e.g. VSS_DATATYPE_UINT8 and true for "uint8[]". Both are read from the node, no string is compared.
+**/
+vssDatatype_t VSSgetDatatypeCode(long nodeHandle);
+bool VSSgetDatatypeIsArray(long nodeHandle);
+
+/**
+* VSSgetRange() returns the min, max and default of the node parsed at load, or NULL if it has none that is a value of its datatype, which then
+* are only available as strings. Array datatypes have no range.
+* VSSCheckRange() compares the value with the min and max of the node and returns a vssRangeResult_t, values of nodes without min or max are in range.
+* VSSCheckRangeBatch() checks count values against their nodes, writes the vssRangeResult_t of each to results, and returns the number of values
+* that are not in range. The bounds are compared as double, so integer bounds above 2^53 in magnitude are rounded.
+**/
+const vssRange_t* VSSgetRange(long nodeHandle);
+int VSSCheckRange(long nodeHandle, double value);
+int VSSCheckRangeBatch(long* nodeHandles, double* values, int count, uint8_t* results);
 char* VSSgetName(long nodeHandle);
 char* VSSgetUUID(long nodeHandle);
 int VSSgetValidation(long nodeHandle);
+
+/**
+* VSSgetInheritedValidation() returns the access control that applies to the node, which is its own validate combined by getMaxValidation()
+* with those of all nodes above it. VSSGetResultValidation() returns the combined inherited access control of the numOfMatches entries
+* of searchData, which is at most the maxFound of the search. Both are table lookups, the inherited values are computed at load.
+**/
+int VSSgetInheritedValidation(long nodeHandle);
+int VSSGetResultValidation(searchData_t* searchData, int numOfMatches);
 char* VSSgetDescr(long nodeHandle);
 int VSSgetNumOfAllowedElements(long nodeHandle);
 char* VSSgetAllowedElement(long nodeHandle, int index);
+
+/**
+* Returns the ordinal of the allowed value of the node, which is its index for VSSgetAllowedElement(), or -1 if the value is not allowed.
+* If a value is listed more than once the first ordinal is returned. Nodes with many allowed values keep them sorted, so the value is then found by a binary search.
+**/
+int VSSgetAllowedOrdinal(long nodeHandle, const char* value);
 char* VSSgetUnit(long nodeHandle);
 uint8_t getMaxValidation(uint8_t newValidation, uint8_t currentMaxValidation);
 uint8_t translateToMatrixIndex(uint8_t index);
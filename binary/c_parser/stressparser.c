@@ -0,0 +1,1146 @@
+/**
+* (C) 2020 Geotab Inc
+* (C) 2018 Volvo Cars
+*
+* All files and artifacts in this repository are licensed under the
+* provisions of the license provided by the LICENSE file in this repository.
+*
+*
+* Multi-threaded stress and throughput test of searches on one shared tree, and on a managed tree that is reloaded during the searches.
+* Before that, checks of the parser on a small tree with known attributes that is written in both formats.
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include "cparserlib.h"
+#include "../binarytool.h"
+
+typedef struct query_t {
+    path_t path;
+    bool anyDepth;
+    int expectedMatches;  // results of the single threaded reference search
+    int expectedValidation;
+    long expectedFirst;
+    long expectedLast;
+    uint32_t expectedFirstIndex;  // the indices are the same in every load of the file, unlike the handles
+    uint32_t expectedLastIndex;
+} query_t;
+
+typedef struct worker_t {
+    pthread_t thread;
+    int index;
+    long searches;
+    bool failed;
+} worker_t;
+
+long rootNode;
+int nodeCount;
+query_t* queries;
+int numOfQueries;
+atomic_bool stopWorkers;
+vssManagedTree_t* managedTree;  // the workers search the managed tree if it is not NULL, else rootNode
+
+static int countNodes(long node) {
+    int count = 1;
+    for (int i = 0 ; i < VSSgetNumOfChildren(node) ; i++) {
+        count += countNodes(VSSgetChild(node, i));
+    }
+    return count;
+}
+
+static int runQuery(query_t* query, long root, searchData_t* searchData, int* validation) {
+    return VSSSearchNodes(query->path, root, nodeCount, searchData, query->anyDepth, false, 0, NULL, validation);
+}
+
+/**
+* The leaf node results of the compact tree search must be the same as those of VSSSearchNodes().
+**/
+static int checkCompactSearch(searchData_t* searchData) {
+    vssCompactTree_t* compact = VSSGetCompactTree(rootNode);
+    uint32_t* found = (uint32_t*) malloc(sizeof(uint32_t)*nodeCount);
+    if (found == NULL) {
+        return -1;
+    }
+    int failed = 0;
+    for (int i = 0 ; i < numOfQueries && failed == 0 ; i++) {
+        int matches = VSSSearchNodes(queries[i].path, rootNode, nodeCount, searchData, queries[i].anyDepth, true, 0, NULL, NULL);
+        failed = VSSCompactSearch(compact, queries[i].path, queries[i].anyDepth, true, found, nodeCount) != matches;
+        for (int j = 0 ; j < matches && failed == 0 ; j++) {
+            failed = searchData[j].foundNodeHandles != compact->handles[found[j]];
+        }
+        if (failed != 0) {
+            printf("Compact search for %s differs from VSSSearchNodes()\n", queries[i].path);
+        }
+    }
+    free(found);
+    return failed;
+}
+
+#define BATCHCHECKMATCHES 64  // the first matches of each query that the batch check compares
+
+typedef struct batchResult_t {
+    uint32_t* found;  // BATCHCHECKMATCHES entries per query
+    int* numOfFound;
+} batchResult_t;
+
+static int saveBatchMatch(int pathNo, long nodeHandle, void* userData) {
+    batchResult_t* result = (batchResult_t*)userData;
+    if (result->numOfFound[pathNo] < BATCHCHECKMATCHES) {
+        result->found[pathNo*BATCHCHECKMATCHES + result->numOfFound[pathNo]] = VSSgetIndex(nodeHandle);
+    }
+    result->numOfFound[pathNo]++;
+    return 0;
+}
+
+/**
+* The matches of each query in one batch of all queries with the same anyDepth must be those of its own compact tree search.
+**/
+static int checkBatchSearch() {
+    vssCompactTree_t* compact = VSSGetCompactTree(rootNode);
+    char** paths = (char**) malloc(sizeof(char*)*numOfQueries);
+    uint32_t* expected = (uint32_t*) malloc(sizeof(uint32_t)*nodeCount);
+    batchResult_t result;
+    result.found = (uint32_t*) malloc(sizeof(uint32_t)*numOfQueries*BATCHCHECKMATCHES);
+    result.numOfFound = (int*) malloc(sizeof(int)*numOfQueries);
+    if (paths == NULL || expected == NULL || result.found == NULL || result.numOfFound == NULL) {
+        return -1;
+    }
+    int failed = 0;
+    for (int anyDepth = 0 ; anyDepth <= 1 && failed == 0 ; anyDepth++) {
+        int numOfPaths = 0;
+        for (int i = 0 ; i < numOfQueries ; i++) {
+            if (queries[i].anyDepth == anyDepth) {
+                result.numOfFound[numOfPaths] = 0;
+                paths[numOfPaths++] = queries[i].path;
+            }
+        }
+        vssBatch_t* batch = VSSCompileBatch(paths, numOfPaths);
+        failed = batch == NULL || VSSSearchBatch(batch, rootNode, anyDepth, false, saveBatchMatch, &result) < 0;
+        for (int i = 0 ; i < numOfPaths && failed == 0 ; i++) {
+            int matches = VSSCompactSearch(compact, paths[i], anyDepth, false, expected, nodeCount);
+            failed = matches != result.numOfFound[i];
+            for (int j = 0 ; j < matches && j < BATCHCHECKMATCHES && failed == 0 ; j++) {
+                failed = expected[j] != result.found[i*BATCHCHECKMATCHES + j];
+            }
+            if (failed != 0) {
+                printf("Batch search for %s differs from the compact tree search\n", paths[i]);
+            }
+        }
+        VSSFreeBatch(batch);
+    }
+    free(paths);
+    free(expected);
+    free(result.found);
+    free(result.numOfFound);
+    return failed;
+}
+
+/**
+* The path index must find the last node of each exact query, which VSSSearchNodes() returns after the ancestors of the node,
+* also when the path is given in lower case.
+**/
+static int checkLookupPath() {
+    for (int i = 0 ; i < numOfQueries ; i++) {
+        if (strchr(queries[i].path, '*') != NULL) {
+            continue;
+        }
+        path_t lowerPath;
+        for (size_t j = 0 ; j <= strlen(queries[i].path) ; j++) {
+            lowerPath[j] = tolower((unsigned char)queries[i].path[j]);
+        }
+        if (VSSLookupPath(rootNode, queries[i].path, false) != queries[i].expectedLast ||
+            VSSLookupPath(rootNode, lowerPath, true) != queries[i].expectedLast) {
+            printf("Path index lookup of %s differs from VSSSearchNodes()\n", queries[i].path);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+* The search of an exact path visits the node and all nodes above it, so the validation that the search folds along the way must equal
+* the inherited validation of the node, and that of the result set, which also holds the nodes above it.
+**/
+static int checkInheritedValidation(query_t* query, searchData_t* searchData) {
+    if (strchr(query->path, '*') != NULL || query->expectedMatches == 0) {
+        return 0;
+    }
+    if (VSSgetInheritedValidation(query->expectedLast) != query->expectedValidation ||
+        VSSGetResultValidation(searchData, query->expectedMatches) != query->expectedValidation) {
+        printf("Inherited validation of %s differs from VSSSearchNodes()\n", query->path);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+* Every node path becomes an exact query, and also a query with a wildcard in place of the parent name of the node,
+* and every branch path is also used as a wildcard query for its subtree.
+**/
+static int createQueries(searchData_t* searchData) {
+    path_t allPaths;
+    snprintf(allPaths, sizeof(allPaths), "%s.*", VSSgetName(rootNode));
+    int numOfNodes = VSSSearchNodes(allPaths, rootNode, nodeCount, searchData, true, false, 0, NULL, NULL);
+    queries = (query_t*) malloc(sizeof(query_t)*numOfNodes*3);
+    if (queries == NULL) {
+        return -1;
+    }
+    numOfQueries = 0;
+    for (int i = 0 ; i < numOfNodes ; i++) {
+        strcpy(queries[numOfQueries].path, searchData[i].responsePaths);
+        queries[numOfQueries++].anyDepth = false;
+        char* nameDelim = strrchr(searchData[i].responsePaths, '.');
+        char* parentDelim = NULL;
+        if (nameDelim != NULL) {
+            *nameDelim = '\0';
+            parentDelim = strrchr(searchData[i].responsePaths, '.');
+            *nameDelim = '.';
+        }
+        if (parentDelim != NULL) {
+            snprintf(queries[numOfQueries].path, MAXCHARSPATH, "%.*s.*%s", (int)(parentDelim - searchData[i].responsePaths), searchData[i].responsePaths, nameDelim);
+            queries[numOfQueries++].anyDepth = false;
+        }
+        if (VSSgetNumOfChildren(searchData[i].foundNodeHandles) > 0 && strlen(searchData[i].responsePaths) + 2 < MAXCHARSPATH) {
+            snprintf(queries[numOfQueries].path, MAXCHARSPATH, "%s.*", searchData[i].responsePaths);
+            queries[numOfQueries++].anyDepth = true;
+        }
+    }
+    if (checkCompactSearch(searchData) != 0) {
+        return -1;
+    }
+    for (int i = 0 ; i < numOfQueries ; i++) {
+        queries[i].expectedMatches = runQuery(&queries[i], rootNode, searchData, &queries[i].expectedValidation);
+        queries[i].expectedFirst = queries[i].expectedMatches > 0 ? searchData[0].foundNodeHandles : 0;
+        queries[i].expectedLast = queries[i].expectedMatches > 0 ? searchData[queries[i].expectedMatches-1].foundNodeHandles : 0;
+        queries[i].expectedFirstIndex = queries[i].expectedFirst != 0 ? VSSgetIndex(queries[i].expectedFirst) : 0;
+        queries[i].expectedLastIndex = queries[i].expectedLast != 0 ? VSSgetIndex(queries[i].expectedLast) : 0;
+        if (checkInheritedValidation(&queries[i], searchData) != 0) {
+            return -1;
+        }
+    }
+    if (checkLookupPath() != 0 || checkBatchSearch() != 0) {
+        return -1;
+    }
+    return numOfQueries;
+}
+
+static void* searchWorker(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    searchData_t* searchData = (searchData_t*) malloc(sizeof(searchData_t)*nodeCount);
+    if (searchData == NULL) {
+        worker->failed = true;
+        return NULL;
+    }
+    int next = (worker->index * 7919) % numOfQueries;  // the workers start at different queries
+    while (atomic_load(&stopWorkers) == false) {
+        query_t* query = &queries[next];
+        int validation;
+        int ticket;
+        long root = managedTree != NULL ? VSSAcquireTree(managedTree, &ticket) : rootNode;
+        int matches = runQuery(query, root, searchData, &validation);
+        bool same = matches == query->expectedMatches && validation == query->expectedValidation;
+        if (same == true && matches > 0 && managedTree != NULL) {
+            same = VSSgetIndex(searchData[0].foundNodeHandles) == query->expectedFirstIndex && VSSgetIndex(searchData[matches-1].foundNodeHandles) == query->expectedLastIndex;
+        } else if (same == true && matches > 0) {
+            same = searchData[0].foundNodeHandles == query->expectedFirst && searchData[matches-1].foundNodeHandles == query->expectedLast;
+        }
+        if (managedTree != NULL) {
+            VSSReleaseTree(managedTree, ticket);
+        }
+        if (same == false) {
+            printf("Thread %d: search for %s gave %d matches, expected %d\n", worker->index, query->path, matches, query->expectedMatches);
+            worker->failed = true;
+            break;
+        }
+        worker->searches++;
+        next = (next + 1) % numOfQueries;
+    }
+    free(searchData);
+    return NULL;
+}
+
+static double elapsedS(struct timespec* start, struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+/**
+* Runs the searches on numOfThreads threads for the given time, and returns the number of searches per second, or -1 on failure.
+* If the managed tree is searched, it is reloaded in a loop meanwhile, and the number of reloads is added to reloads.
+**/
+static double runThreads(int numOfThreads, int runMs, int* reloads) {
+    worker_t* workers = (worker_t*) calloc(numOfThreads, sizeof(worker_t));
+    if (workers == NULL) {
+        return -1;
+    }
+    struct timespec start, end;
+    struct timespec runTime = {runMs / 1000, (runMs % 1000) * 1000000L};
+    atomic_store(&stopWorkers, false);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int started = 0;
+    for ( ; started < numOfThreads ; started++) {
+        workers[started].index = started;
+        if (pthread_create(&workers[started].thread, NULL, searchWorker, &workers[started]) != 0) {
+            break;
+        }
+    }
+    bool reloadFailed = false;
+    if (managedTree != NULL) {
+        struct timespec now;
+        do {
+            if (VSSReloadManagedTree(managedTree, true) != VSS_OK) {
+                reloadFailed = true;
+                break;
+            }
+            (*reloads)++;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+        } while (elapsedS(&start, &now) * 1000 < runMs);
+    } else {
+        nanosleep(&runTime, NULL);
+    }
+    atomic_store(&stopWorkers, true);
+    long searches = 0;
+    bool failed = started < numOfThreads || reloadFailed;
+    for (int i = 0 ; i < started ; i++) {
+        pthread_join(workers[i].thread, NULL);
+        searches += workers[i].searches;
+        failed = failed || workers[i].failed;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(workers);
+    return failed ? -1 : searches / elapsedS(&start, &end);
+}
+
+/**
+* The check tree is a root branch with the nodes below as its children, in this order.
+**/
+#define MAXCHECKALLOWED 12
+
+typedef struct checkNode_t {
+    char* name;
+    char* type;
+    char* datatype;
+    char* min;
+    char* max;
+    char* unit;
+    char* defaultValue;
+    char* allowed[MAXCHECKALLOWED];  // ends at the first NULL
+    int descrLen;  // length of a generated description, or 0 for a short one with the name
+} checkNode_t;
+
+static checkNode_t checkNodes[] = {
+    {"MinOnly", "sensor", "int8", "-10", "", "km", "", {NULL}, 0},
+    {"MaxOnly", "sensor", "uint16", "", "1000", "km", "", {NULL}, 0},
+    {"MinMax", "sensor", "float", "-1.5", "2.5", "m/s", "0.5", {NULL}, 0},
+    {"Unsigned", "actuator", "uint8", "10", "200", "", "20", {NULL}, 0},
+    {"UnsignedOverflow", "sensor", "uint8", "", "300", "", "", {NULL}, 0},  // not a uint8, so there is no max
+    {"SignedOverflow", "sensor", "int8", "-200", "100", "", "", {NULL}, 0},
+    {"Flag", "actuator", "boolean", "false", "true", "", "true", {NULL}, 0},
+    {"Array", "sensor", "uint8[]", "0", "10", "", "", {NULL}, 0},  // arrays have no range
+    {"NotFinite", "sensor", "double", "-inf", "nan", "", "", {NULL}, 0},
+    {"FewAllowed", "sensor", "string", "", "", "", "Two", {"One", "Two", "Three", NULL}, 0},  // scanned
+    {"ManyAllowed", "actuator", "string", "", "", "", "", {"Zulu", "Alpha", "Echo", "Bravo", "X", "Delta", "Charlie", "Foxtrot", "Golf", "Hotel", NULL}, 0},  // binary searched
+    {"Descr127", "sensor", "string", "", "", "", "", {NULL}, 127},  // the varint length boundaries
+    {"Descr128", "sensor", "string", "", "", "", "", {NULL}, 128},
+    {"Descr16383", "sensor", "string", "", "", "", "", {NULL}, 16383},
+    {"Descr16384", "sensor", "string", "", "", "", "", {NULL}, 16384},
+};
+
+#define NUMOFCHECKNODES (int)(sizeof(checkNodes)/sizeof(checkNodes[0]))
+
+static void checkDescription(checkNode_t* node, char* descr, size_t size) {
+    if (node->descrLen == 0) {
+        snprintf(descr, size, "Check node %s.", node->name);
+        return;
+    }
+    for (int i = 0 ; i < node->descrLen ; i++) {
+        descr[i] = 'a' + i % 26;
+    }
+    descr[node->descrLen] = '\0';
+}
+
+#define MAXCHECKDESCRLEN 16384
+
+static int writeCheckTree(char* fname, int formatVersion) {
+    binaryWriter_t* writer = openBinaryCtree(fname, formatVersion);
+    char* descr = (char*) malloc(MAXCHECKDESCRLEN+1);
+    if (writer == NULL || descr == NULL) {
+        free(descr);
+        return -1;
+    }
+    appendBinaryCnode(writer, "Vehicle", "branch", "uuid-Vehicle", "Root of the check tree.", "", "", "", "", "", "", "", NUMOFCHECKNODES);
+    for (int i = 0 ; i < NUMOFCHECKNODES ; i++) {
+        checkNode_t* node = &checkNodes[i];
+        char uuid[64];
+        char allowed[256] = "";
+        snprintf(uuid, sizeof(uuid), "uuid-%s", node->name);
+        checkDescription(node, descr, MAXCHECKDESCRLEN+1);
+        for (int j = 0 ; node->allowed[j] != NULL ; j++) {
+            snprintf(allowed + strlen(allowed), sizeof(allowed) - strlen(allowed), "%02X%s", (unsigned)strlen(node->allowed[j]), node->allowed[j]);
+        }
+        appendBinaryCnode(writer, node->name, node->type, uuid, descr, node->datatype, node->min, node->max, node->unit, allowed, node->defaultValue, "", 0);
+    }
+    free(descr);
+    return closeBinaryCtree(writer);
+}
+
+typedef struct rangeCheck_t {
+    int node;  // index in checkNodes
+    double value;
+    int expected;
+} rangeCheck_t;
+
+static rangeCheck_t rangeChecks[] = {
+    {0, -10, VSS_IN_RANGE}, {0, -10.5, VSS_BELOW_MIN}, {0, 1e300, VSS_IN_RANGE},
+    {1, -1e300, VSS_IN_RANGE}, {1, 1000, VSS_IN_RANGE}, {1, 1001, VSS_ABOVE_MAX},
+    {2, -1.5, VSS_IN_RANGE}, {2, -1.6, VSS_BELOW_MIN}, {2, 2.5, VSS_IN_RANGE}, {2, 2.6, VSS_ABOVE_MAX}, {2, NAN, VSS_NOT_A_NUMBER},
+    {3, 9, VSS_BELOW_MIN}, {3, 10, VSS_IN_RANGE}, {3, 200, VSS_IN_RANGE}, {3, 201, VSS_ABOVE_MAX},
+    {4, 1e9, VSS_IN_RANGE}, {4, -1e9, VSS_IN_RANGE},
+    {5, -1e9, VSS_IN_RANGE}, {5, 100, VSS_IN_RANGE}, {5, 101, VSS_ABOVE_MAX},
+    {6, -1, VSS_BELOW_MIN}, {6, 0, VSS_IN_RANGE}, {6, 1, VSS_IN_RANGE}, {6, 2, VSS_ABOVE_MAX},
+    {7, 11, VSS_IN_RANGE}, {7, -1, VSS_IN_RANGE},
+    {8, 1e308, VSS_IN_RANGE}, {8, -1e308, VSS_IN_RANGE},
+};
+
+#define NUMOFRANGECHECKS (int)(sizeof(rangeChecks)/sizeof(rangeChecks[0]))
+
+/**
+* VSSCheckRange() and VSSCheckRangeBatch() must give the expected result for each value, and VSSgetRange() the given bounds,
+* where a bound that is not a value of the datatype is not given.
+**/
+static int checkRanges(char* label, long root) {
+    long nodeHandles[NUMOFRANGECHECKS];
+    double values[NUMOFRANGECHECKS];
+    uint8_t results[NUMOFRANGECHECKS];
+    int expectedOutOfRange = 0;
+    for (int i = 0 ; i < NUMOFRANGECHECKS ; i++) {
+        nodeHandles[i] = VSSgetChild(root, rangeChecks[i].node);
+        values[i] = rangeChecks[i].value;
+        expectedOutOfRange += rangeChecks[i].expected != VSS_IN_RANGE;
+        if (VSSCheckRange(nodeHandles[i], values[i]) != rangeChecks[i].expected) {
+            printf("%s: VSSCheckRange() of %s with %g is not %d\n", label, checkNodes[rangeChecks[i].node].name, values[i], rangeChecks[i].expected);
+            return 1;
+        }
+    }
+    if (VSSCheckRangeBatch(nodeHandles, values, NUMOFRANGECHECKS, results) != expectedOutOfRange) {
+        printf("%s: VSSCheckRangeBatch() out of range count differs\n", label);
+        return 1;
+    }
+    for (int i = 0 ; i < NUMOFRANGECHECKS ; i++) {
+        if (results[i] != rangeChecks[i].expected) {
+            printf("%s: VSSCheckRangeBatch() of %s with %g is not %d\n", label, checkNodes[rangeChecks[i].node].name, values[i], rangeChecks[i].expected);
+            return 1;
+        }
+    }
+    const vssRange_t* range = VSSgetRange(VSSgetChild(root, 3));
+    if (range == NULL || range->flags != (VSS_HAS_MIN | VSS_HAS_MAX | VSS_HAS_DEFAULT) || range->min.u != 10 || range->max.u != 200 || range->defaultValue.u != 20) {
+        printf("%s: range of Unsigned differs\n", label);
+        return 1;
+    }
+    range = VSSgetRange(VSSgetChild(root, 6));
+    if (range == NULL || range->min.u != 0 || range->max.u != 1 || range->defaultValue.u != 1) {
+        printf("%s: range of Flag differs\n", label);
+        return 1;
+    }
+    if (VSSgetRange(VSSgetChild(root, 4)) != NULL || VSSgetRange(VSSgetChild(root, 7)) != NULL || VSSgetRange(VSSgetChild(root, 8)) != NULL) {
+        printf("%s: a node without valid bounds has a range\n", label);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+* VSSgetAllowedOrdinal() must return the index of each allowed value in the file, and -1 for a value that is not allowed,
+* both with the few values that are scanned and with the many values that are binary searched.
+**/
+static int checkAllowed(char* label, long root) {
+    static char* unknownValues[] = {"", "Four", "Zul", "Zulus", "one", "Y"};
+    for (int i = 0 ; i < NUMOFCHECKNODES ; i++) {
+        long node = VSSgetChild(root, i);
+        int count = 0;
+        for ( ; checkNodes[i].allowed[count] != NULL ; count++) {
+            char* element = VSSgetAllowedElement(node, count);
+            if (VSSgetAllowedOrdinal(node, checkNodes[i].allowed[count]) != count || element == NULL || strcmp(element, checkNodes[i].allowed[count]) != 0) {
+                printf("%s: allowed value %s of %s is not at ordinal %d\n", label, checkNodes[i].allowed[count], checkNodes[i].name, count);
+                return 1;
+            }
+        }
+        if (VSSgetNumOfAllowedElements(node) != count) {
+            printf("%s: %s has %d allowed values, expected %d\n", label, checkNodes[i].name, VSSgetNumOfAllowedElements(node), count);
+            return 1;
+        }
+        for (int j = 0 ; j < (int)(sizeof(unknownValues)/sizeof(unknownValues[0])) ; j++) {
+            if (VSSgetAllowedOrdinal(node, unknownValues[j]) != -1) {
+                printf("%s: %s allows the unknown value \"%s\"\n", label, checkNodes[i].name, unknownValues[j]);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+* VSSSearchNodes() must return the number of entries it writes, which is at most maxFound, as callers loop over them.
+**/
+static int checkSearchCap(char* label, long root) {
+    searchData_t* searchData = (searchData_t*) malloc(sizeof(searchData_t)*(NUMOFCHECKNODES+1));
+    if (searchData == NULL) {
+        return 1;
+    }
+    int capped = VSSSearchNodes("Vehicle.*", root, 2, searchData, true, false, 0, NULL, NULL);
+    int all = VSSSearchNodes("Vehicle.*", root, NUMOFCHECKNODES+1, searchData, true, false, 0, NULL, NULL);
+    free(searchData);
+    if (capped != 2 || all != NUMOFCHECKNODES+1) {
+        printf("%s: VSSSearchNodes() returned %d and %d entries, expected 2 and %d\n", label, capped, all, NUMOFCHECKNODES+1);
+        return 1;
+    }
+    return 0;
+}
+
+static bool sameString(char* str1, char* str2) {
+    return str1 == NULL || str2 == NULL ? str1 == str2 : strcmp(str1, str2) == 0;
+}
+
+static bool sameRange(const vssRange_t* range1, const vssRange_t* range2) {
+    if (range1 == NULL || range2 == NULL) {
+        return range1 == range2;
+    }
+    return range1->flags == range2->flags && range1->min.u == range2->min.u && range1->max.u == range2->max.u && range1->defaultValue.u == range2->defaultValue.u;
+}
+
+/**
+* The attribute getters of the node and its subtree in a lazily loaded tree must return what they return in an eagerly loaded tree.
+**/
+static bool sameAttributes(long eagerNode, long lazyNode) {
+    if (sameString(VSSgetUUID(eagerNode), VSSgetUUID(lazyNode)) == false || sameString(VSSgetDescr(eagerNode), VSSgetDescr(lazyNode)) == false ||
+        sameString(VSSgetUnit(eagerNode), VSSgetUnit(lazyNode)) == false || sameRange(VSSgetRange(eagerNode), VSSgetRange(lazyNode)) == false ||
+        VSSgetNumOfAllowedElements(eagerNode) != VSSgetNumOfAllowedElements(lazyNode)) {
+        printf("Lazy attributes of %s differ from the eager load\n", VSSgetName(eagerNode));
+        return false;
+    }
+    for (int i = 0 ; i < VSSgetNumOfAllowedElements(eagerNode) ; i++) {
+        if (sameString(VSSgetAllowedElement(eagerNode, i), VSSgetAllowedElement(lazyNode, i)) == false) {
+            printf("Lazy allowed value %d of %s differs from the eager load\n", i, VSSgetName(eagerNode));
+            return false;
+        }
+    }
+    for (int i = 0 ; i < VSSgetNumOfChildren(eagerNode) ; i++) {
+        if (sameAttributes(VSSgetChild(eagerNode, i), VSSgetChild(lazyNode, i)) == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+typedef struct lazyWorker_t {
+    pthread_t thread;
+    long eagerRoot;
+    long lazyRoot;
+    bool failed;
+} lazyWorker_t;
+
+static void* lazyWorker(void* arg) {
+    lazyWorker_t* worker = (lazyWorker_t*)arg;
+    vssTreeStats_t stats;
+    vssAttributeBytes_t bytes;
+    worker->failed = sameAttributes(worker->eagerRoot, worker->lazyRoot) == false;
+    VSSGetTreeStats(worker->lazyRoot, &stats);  // while the other workers may decode
+    VSSGetAttributeBytes(worker->lazyRoot, &bytes);
+    return NULL;
+}
+
+#define LAZYCHECKTHREADS 4
+
+/**
+* The attributes of a lazily loaded format version 2 tree, read and mapped, must be those of the eager load,
+* also when several threads trigger the decoding of the same nodes.
+**/
+static int checkLazyLoad(char* fname) {
+    int status;
+    long eagerRoot = VSSLoadTree(fname, VSS_LOAD_QUIET, &status);
+    int failed = eagerRoot == 0;
+    for (int mmap = 0 ; mmap <= 1 && failed == 0 ; mmap++) {
+        long lazyRoot = VSSLoadTree(fname, VSS_LOAD_LAZY | VSS_LOAD_QUIET | (mmap == 1 ? VSS_LOAD_MMAP : 0), &status);
+        if (lazyRoot == 0) {
+            failed = 1;
+            break;
+        }
+        lazyWorker_t workers[LAZYCHECKTHREADS];
+        int started = 0;
+        for ( ; started < LAZYCHECKTHREADS ; started++) {
+            workers[started].eagerRoot = eagerRoot;
+            workers[started].lazyRoot = lazyRoot;
+            if (pthread_create(&workers[started].thread, NULL, lazyWorker, &workers[started]) != 0) {
+                failed = 1;
+                break;
+            }
+        }
+        for (int i = 0 ; i < started ; i++) {
+            pthread_join(workers[i].thread, NULL);
+            failed = failed || workers[i].failed;
+        }
+        VSSFreeTree(lazyRoot);
+    }
+    VSSFreeTree(eagerRoot);
+    if (failed != 0) {
+        printf("Lazy load check of %s failed\n", fname);
+    }
+    return failed;
+}
+
+/**
+* The getters of the classes in the mask must return what they return in the tree with all classes, and those of the other classes NULL or nothing.
+**/
+static bool maskedAttributes(long fullNode, long maskedNode, int mask) {
+    bool same = sameString((mask & VSS_ATTR_UUID) != 0 ? VSSgetUUID(fullNode) : NULL, VSSgetUUID(maskedNode)) &&
+                sameString((mask & VSS_ATTR_DESCR) != 0 ? VSSgetDescr(fullNode) : NULL, VSSgetDescr(maskedNode)) &&
+                sameString((mask & VSS_ATTR_UNIT) != 0 ? VSSgetUnit(fullNode) : NULL, VSSgetUnit(maskedNode)) &&
+                sameRange((mask & VSS_ATTR_RANGE) != 0 ? VSSgetRange(fullNode) : NULL, VSSgetRange(maskedNode)) &&
+                ((mask & VSS_ATTR_ALLOWED) != 0 ? VSSgetNumOfAllowedElements(fullNode) : 0) == VSSgetNumOfAllowedElements(maskedNode) &&
+                sameString(VSSgetName(fullNode), VSSgetName(maskedNode)) && sameString(VSSgetDatatype(fullNode), VSSgetDatatype(maskedNode));
+    for (int i = 0 ; i < VSSgetNumOfAllowedElements(maskedNode) && same == true ; i++) {
+        same = sameString(VSSgetAllowedElement(fullNode, i), VSSgetAllowedElement(maskedNode, i));
+    }
+    if (same == false) {
+        printf("Attributes of %s with mask %d differ\n", VSSgetName(fullNode), mask);
+        return false;
+    }
+    for (int i = 0 ; i < VSSgetNumOfChildren(fullNode) ; i++) {
+        if (maskedAttributes(VSSgetChild(fullNode, i), VSSgetChild(maskedNode, i), mask) == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int checkMasks[] = {VSS_ATTR_UNIT | VSS_ATTR_RANGE, VSS_ATTR_UUID | VSS_ATTR_DESCR | VSS_ATTR_ALLOWED, 0};
+
+/**
+* Loads the file with each attribute mask, and checks that VSSWriteTree() refuses a tree with dropped classes,
+* and that it writes a tree with all classes that loads with the same attributes.
+**/
+static int checkAttributeMask(char* label, char* fname, int loadFlags) {
+    int status;
+    long fullRoot = VSSLoadTree(fname, loadFlags, &status);
+    int failed = fullRoot == 0;
+    char* writtenFname = "stresscheck_written.binary";
+    for (int i = 0 ; i < (int)(sizeof(checkMasks)/sizeof(checkMasks[0])) && failed == 0 ; i++) {
+        long maskedRoot = VSSLoadTreeAttributes(fname, loadFlags, checkMasks[i], &status);
+        failed = maskedRoot == 0 || maskedAttributes(fullRoot, maskedRoot, checkMasks[i]) == false;
+        if (failed == 0) {
+            remove(writtenFname);
+            VSSWriteTree(writtenFname, maskedRoot);
+            failed = access(writtenFname, F_OK) == 0;
+        }
+        VSSFreeTree(maskedRoot);
+    }
+    if (failed == 0) {
+        VSSWriteTree(writtenFname, fullRoot);
+        long writtenRoot = VSSLoadTree(writtenFname, VSS_LOAD_QUIET, &status);
+        failed = writtenRoot == 0 || maskedAttributes(fullRoot, writtenRoot, VSS_ATTR_ALL) == false;
+        VSSFreeTree(writtenRoot);
+    }
+    remove(writtenFname);
+    VSSFreeTree(fullRoot);
+    if (failed != 0) {
+        printf("%s: attribute mask check failed\n", label);
+    }
+    return failed;
+}
+
+/**
+* Writes len bytes of buf to fname, and checks that the load of it fails with the expected status.
+**/
+static int checkLoadFails(char* label, char* fname, char* buf, long len, int loadFlags, int expectedStatus) {
+    FILE* fp = fopen(fname, "w");
+    if (fp == NULL || (len > 0 && fwrite(buf, 1, len, fp) != (size_t)len)) {
+        if (fp != NULL) {
+            fclose(fp);
+        }
+        return 1;
+    }
+    fclose(fp);
+    int status = VSS_OK;
+    long root = VSSLoadTree(fname, loadFlags, &status);
+    if (root != 0 || status != expectedStatus) {
+        printf("%s: load gave %s, expected %s\n", label, root != 0 ? "a tree" : VSSGetStatusText(status), VSSGetStatusText(expectedStatus));
+        VSSFreeTree(root);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+* Returns the offset of the length prefix of the field in the format version 1 record at recordStart, or of the number of children if field is NUMOFNODEFIELDS.
+**/
+static long fieldOffsetV1(unsigned char* buf, long recordStart, int field) {
+    static const int lenBytes[NUMOFNODEFIELDS] = {1, 1, 1, 2, 1, 1, 1, 1, 2, 1, 1};
+    long pos = recordStart;
+    for (int i = 0 ; i < field ; i++) {
+        pos += lenBytes[i] + (lenBytes[i] == 1 ? buf[pos] : buf[pos] | buf[pos+1] << 8);
+    }
+    return pos;
+}
+
+/**
+* A format version 1 file that is truncated, at every byte near its start and end and at a stride in between, that has a field longer than the rest of the file,
+* or a wrong number of children, must fail the load with the status of the damage and without a tree.
+**/
+static int checkCorruptV1(char* fname) {
+    char* corruptFname = "stresscheck_corrupt.binary";
+    FILE* fp = fopen(fname, "r");
+    long len = fp != NULL && fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+    char* buf = len > 0 ? (char*) malloc(len) : NULL;
+    int failed = buf == NULL || fseek(fp, 0, SEEK_SET) != 0 || fread(buf, 1, len, fp) != (size_t)len;
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    char label[96];  // room for two longs
+    for (long cut = 0 ; cut < len && failed == 0 ; cut += cut < 256 || cut >= len - 256 ? 1 : 97) {  // every byte of the first and last records
+        snprintf(label, sizeof(label), "format 1 cut at %ld of %ld bytes", cut, len);
+        failed = checkLoadFails(label, corruptFname, buf, cut, VSS_LOAD_QUIET, VSS_ERR_TRUNCATED);
+    }
+    if (failed == 0) {
+        long descrLen = fieldOffsetV1((unsigned char*)buf, 0, DESCRFIELD);
+        char saved[2] = {buf[descrLen], buf[descrLen+1]};
+        buf[descrLen] = buf[descrLen+1] = (char)0xFF;
+        failed = checkLoadFails("format 1 overlong description", corruptFname, buf, len, VSS_LOAD_QUIET, VSS_ERR_TRUNCATED);
+        buf[descrLen] = saved[0];
+        buf[descrLen+1] = saved[1];
+    }
+    long children = fieldOffsetV1((unsigned char*)buf, 0, NUMOFNODEFIELDS);
+    if (failed == 0) {
+        buf[children] = NUMOFCHECKNODES - 1;  // the last node is left over
+        failed = checkLoadFails("format 1 too few children", corruptFname, buf, len, VSS_LOAD_QUIET, VSS_ERR_CORRUPT);
+    }
+    if (failed == 0) {
+        buf[children] = NUMOFCHECKNODES + 1;  // the file ends before the last child
+        failed = checkLoadFails("format 1 too many children", corruptFname, buf, len, VSS_LOAD_QUIET, VSS_ERR_TRUNCATED);
+    }
+    if (failed == 0) {
+        buf[children] = NUMOFCHECKNODES;
+        buf[len-1] = 1;  // the last node is a leaf that claims a child
+        failed = checkLoadFails("format 1 leaf with a child", corruptFname, buf, len, VSS_LOAD_QUIET, VSS_ERR_TRUNCATED);
+    }
+    remove(corruptFname);
+    free(buf);
+    return failed;
+}
+
+/**
+* Loads the file with stdout redirected to a temporary file, and returns the number of bytes that the load printed, or -1 on failure.
+**/
+static long loadPrintout(char* fname, int loadFlags, long* root) {
+    int status;
+    FILE* capture = tmpfile();
+    int savedFd = dup(STDOUT_FILENO);
+    if (capture == NULL || savedFd < 0) {
+        return -1;
+    }
+    fflush(stdout);
+    dup2(fileno(capture), STDOUT_FILENO);
+    *root = VSSLoadTree(fname, loadFlags, &status);
+    fflush(stdout);
+    dup2(savedFd, STDOUT_FILENO);
+    close(savedFd);
+    long len = (long)lseek(fileno(capture), 0, SEEK_END);
+    fclose(capture);
+    return len;
+}
+
+/**
+* A load with VSS_LOAD_QUIET must print nothing, unlike one without it, and the statistics must count the nodes of the check tree by type.
+**/
+static int checkStats(char* label, char* fname, int loadFlags) {
+    long root;
+    long printed = loadPrintout(fname, loadFlags & ~VSS_LOAD_QUIET, &root);
+    VSSFreeTree(root);
+    if (root == 0 || printed <= 0) {
+        printf("%s: the load without VSS_LOAD_QUIET printed nothing\n", label);
+        return 1;
+    }
+    printed = loadPrintout(fname, loadFlags | VSS_LOAD_QUIET, &root);
+    if (root == 0 || printed != 0) {
+        printf("%s: the load with VSS_LOAD_QUIET printed %ld bytes\n", label, printed);
+        VSSFreeTree(root);
+        return 1;
+    }
+    uint32_t expectedPerType[VSS_NUMOFNODETYPES] = {0};
+    expectedPerType[BRANCH] = 1;
+    for (int i = 0 ; i < NUMOFCHECKNODES ; i++) {
+        expectedPerType[strcmp(checkNodes[i].type, "sensor") == 0 ? SENSOR : ACTUATOR]++;
+    }
+    vssTreeStats_t stats;
+    VSSGetTreeStats(root, &stats);
+    VSSFreeTree(root);
+    int failed = stats.totalNodes != NUMOFCHECKNODES + 1 || stats.maxDepth != 2 || stats.bytesRead == 0;
+    for (int i = 0 ; i < VSS_NUMOFNODETYPES ; i++) {
+        failed = failed || stats.nodesPerType[i] != expectedPerType[i];
+    }
+    if (failed != 0) {
+        printf("%s: the statistics of the load differ from the check tree\n", label);
+    }
+    return failed;
+}
+
+static uint32_t varintValues[] = {0, 127, 128, 16383, 16384, 2097151, 2097152, 268435455, 268435456, UINT32_MAX};
+static int varintLens[] = {1, 1, 2, 2, 3, 3, 4, 4, 5, 5};
+
+/**
+* Each boundary value must be written by the writer in the expected number of bytes and be decoded back by the parser, both at the end of the input
+* and with more input after it, which the decoder takes different paths for, and a varint that is cut off or longer than 32 bits must be corrupt.
+**/
+static int checkVarints() {
+    uint8_t buf[V2MAXVARINTLEN+8];
+    for (int i = 0 ; i < (int)(sizeof(varintValues)/sizeof(varintValues[0])) ; i++) {
+        memset(buf, 0x80, sizeof(buf));
+        int len = encodeVarint(buf, varintValues[i]);
+        for (int padding = 0 ; padding <= 8 ; padding += 8) {
+            const uint8_t* cursor = buf;
+            uint32_t value;
+            if (len != varintLens[i] || VSSDecodeVarint(&cursor, buf + len + padding, &value) != VSS_OK || value != varintValues[i] || cursor != buf + len) {
+                printf("Varint %u does not round trip with %d bytes after it\n", varintValues[i], padding);
+                return 1;
+            }
+        }
+        const uint8_t* cursor = buf;
+        uint32_t value;
+        if (VSSDecodeVarint(&cursor, buf + len - 1, &value) != VSS_ERR_CORRUPT) {
+            printf("Varint %u cut off at %d bytes is not corrupt\n", varintValues[i], len - 1);
+            return 1;
+        }
+    }
+    static const uint8_t tooLong[][V2MAXVARINTLEN+1] = {{0xFF, 0xFF, 0xFF, 0xFF, 0x10, 0x00}, {0x80, 0x80, 0x80, 0x80, 0x80, 0x00}};
+    for (int i = 0 ; i < 2 ; i++) {
+        for (int padding = 0 ; padding <= 1 ; padding++) {
+            const uint8_t* cursor = tooLong[i];
+            uint32_t value;
+            if (VSSDecodeVarint(&cursor, tooLong[i] + V2MAXVARINTLEN + padding, &value) != VSS_ERR_CORRUPT) {
+                printf("Varint longer than 32 bits is not corrupt\n");
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+* The descriptions, whose lengths are the varint boundaries in format version 2, must be read back whole.
+**/
+static int checkDescriptions(char* label, long root) {
+    char* descr = (char*) malloc(MAXCHECKDESCRLEN+1);
+    int failed = descr == NULL;
+    for (int i = 0 ; i < NUMOFCHECKNODES && failed == 0 ; i++) {
+        checkDescription(&checkNodes[i], descr, MAXCHECKDESCRLEN+1);
+        if (sameString(VSSgetDescr(VSSgetChild(root, i)), descr) == false) {
+            printf("%s: description of %s differs\n", label, checkNodes[i].name);
+            failed = 1;
+        }
+    }
+    free(descr);
+    return failed;
+}
+
+static uint32_t readUint32(const unsigned char* buf) {
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+/**
+* A format version 2 file whose node section ends within a varint must fail the load and the stream as corrupt, and not read past the section.
+**/
+static int checkTruncatedVarint(char* fname) {
+    char* corruptFname = "stresscheck_corrupt.binary";
+    FILE* fp = fopen(fname, "r");
+    long len = fp != NULL && fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+    char* buf = len > V2HEADERSIZE ? (char*) malloc(len) : NULL;
+    int failed = buf == NULL || fseek(fp, 0, SEEK_SET) != 0 || fread(buf, 1, len, fp) != (size_t)len;
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    if (failed == 0) {
+        uint32_t nodeCount = readUint32((unsigned char*)&buf[8]);
+        uint32_t nodeSectionSize = readUint32((unsigned char*)&buf[20]);
+        buf[V2HEADERSIZE + sizeof(uint32_t)*nodeCount + nodeSectionSize - 1] = (char)0x80;  // the last byte of the last record continues
+        failed = checkLoadFails("format 2 truncated varint", corruptFname, buf, len, VSS_LOAD_QUIET, VSS_ERR_CORRUPT) ||
+                 checkLoadFails("format 2 mmap truncated varint", corruptFname, buf, len, VSS_LOAD_MMAP | VSS_LOAD_QUIET, VSS_ERR_CORRUPT);
+    }
+    if (failed == 0 && VSSParseStream(corruptFname, NULL, NULL, NULL) != VSS_ERR_CORRUPT) {
+        printf("format 2 truncated varint: the stream is not corrupt\n");
+        failed = 1;
+    }
+    remove(corruptFname);
+    free(buf);
+    return failed;
+}
+
+static void packUint32(char* buf, size_t* len, uint32_t value) {
+    for (int i = 0 ; i < 4 ; i++) {
+        buf[(*len)++] = (char)((value >> 8*i) & 0xFF);
+    }
+}
+
+static void packBytes(char* buf, size_t* len, const char* str, uint32_t strLen) {
+    packUint32(buf, len, strLen);
+    memcpy(&buf[*len], str, strLen);
+    *len += strLen;
+}
+
+#define LONGALLOWEDLEN 300
+
+/**
+* Format version 2 has no limit on the length of an allowed value, so a value longer than the 255 bytes of the format version 1
+* hex length must survive createBinaryCtree() and a load unchanged.
+**/
+static int checkLongAllowed() {
+    char* fname = "stresscheck_allowed.binary";
+    char longValue[LONGALLOWEDLEN+1];
+    for (int i = 0 ; i < LONGALLOWEDLEN ; i++) {
+        longValue[i] = 'A' + i % 26;
+    }
+    longValue[LONGALLOWEDLEN] = '\0';
+    char* fields[2][NUMOFNODEFIELDS] = {{"Vehicle", "branch", "", "", "", "", "", "", "", "", ""},
+                                        {"Long", "sensor", "", "", "string", "", "", "", "", "", ""}};
+    char* packed = (char*) malloc(4096);
+    size_t len = 0;
+    if (packed == NULL) {
+        return 1;
+    }
+    for (int node = 0 ; node < 2 ; node++) {
+        for (int i = 0 ; i < NUMOFNODEFIELDS ; i++) {
+            if (node == 1 && i == ALLOWEDFIELD) {  // a uint32 count, and a uint32 length and the bytes of each element
+                packUint32(packed, &len, 4 + 4 + LONGALLOWEDLEN + 4 + 5);
+                packUint32(packed, &len, 2);
+                packBytes(packed, &len, longValue, LONGALLOWEDLEN);
+                packBytes(packed, &len, "Short", 5);
+            } else {
+                packBytes(packed, &len, fields[node][i], (uint32_t)strlen(fields[node][i]));
+            }
+        }
+        packUint32(packed, &len, 1 - node);
+    }
+    int failed = createBinaryCtree(fname, packed, len, 2, 2) != 0;
+    free(packed);
+    int status;
+    long root = failed == 0 ? VSSLoadTree(fname, VSS_LOAD_QUIET, &status) : 0;
+    long node = root != 0 ? VSSgetChild(root, 0) : 0;
+    char* element = node != 0 ? VSSgetAllowedElement(node, 0) : NULL;
+    if (node == 0 || VSSgetNumOfAllowedElements(node) != 2 || element == NULL || strcmp(element, longValue) != 0 ||
+        VSSgetAllowedOrdinal(node, longValue) != 0 || VSSgetAllowedOrdinal(node, "Short") != 1) {
+        printf("format 2 allowed value of %d bytes does not round trip\n", LONGALLOWEDLEN);
+        failed = 1;
+    }
+    if (root != 0) {
+        VSSFreeTree(root);
+    }
+    remove(fname);
+    return failed;
+}
+
+typedef struct streamCheck_t {
+    long* nodes;          // the nodes of the loaded tree in pre-order
+    uint32_t* depths;
+    int* subtreeEnds;     // the pre-order position after the subtree of each node
+    int numOfNodes;
+    int entered;
+    int left;
+    int stopAt;           // position at which the enter callback stops the parse, or -1
+    bool failed;
+} streamCheck_t;
+
+static bool sameField(const char* field, uint32_t len, char* str) {
+    return str == NULL || str[0] == '\0' ? len == 0 : len == strlen(str) && memcmp(field, str, len) == 0;
+}
+
+/**
+* Stores the subtree of the node in pre-order, and returns the position after it.
+**/
+static int collectPreOrder(streamCheck_t* check, long node, uint32_t depth, int pos) {
+    int self = pos++;
+    check->nodes[self] = node;
+    check->depths[self] = depth;
+    for (int i = 0 ; i < VSSgetNumOfChildren(node) ; i++) {
+        pos = collectPreOrder(check, VSSgetChild(node, i), depth + 1, pos);
+    }
+    check->subtreeEnds[self] = pos;
+    return pos;
+}
+
+static int enterView(const vssNodeView_t* view, void* userData) {
+    streamCheck_t* check = (streamCheck_t*)userData;
+    if (check->entered >= check->numOfNodes) {
+        check->failed = true;
+        return 1;
+    }
+    long node = check->nodes[check->entered];
+    if (sameField(view->name, view->nameLen, VSSgetName(node)) == false || view->type != VSSgetType(node) ||
+        view->children != (uint32_t)VSSgetNumOfChildren(node) || view->index != (uint32_t)check->entered || view->index != VSSgetIndex(node) ||
+        view->depth != check->depths[check->entered] || sameField(view->uuid, view->uuidLen, VSSgetUUID(node)) == false ||
+        sameField(view->datatype, view->datatypeLen, VSSgetDatatype(node)) == false) {
+        printf("Streamed node %u %.*s differs from the loaded tree\n", view->index, (int)view->nameLen, view->name);
+        check->failed = true;
+        return 1;
+    }
+    return check->entered++ == check->stopAt;
+}
+
+static int leaveView(const vssNodeView_t* view, void* userData) {
+    streamCheck_t* check = (streamCheck_t*)userData;
+    check->left++;
+    if (view->index >= (uint32_t)check->numOfNodes || check->entered != check->subtreeEnds[view->index]) {
+        printf("Streamed node %u %.*s is left before the end of its subtree\n", view->index, (int)view->nameLen, view->name);
+        check->failed = true;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+* VSSParseStream() must pass the nodes of the loaded tree in pre-order to the enter callback, and each node after its subtree to the leave callback,
+* and an enter callback that returns non-zero must stop the parse with VSS_OK.
+**/
+static int checkStream(char* fname) {
+    int status;
+    long root = VSSLoadTree(fname, VSS_LOAD_QUIET, &status);
+    if (root == 0) {
+        return 1;
+    }
+    streamCheck_t check;
+    check.numOfNodes = countNodes(root);
+    check.nodes = (long*) malloc(sizeof(long)*check.numOfNodes);
+    check.depths = (uint32_t*) malloc(sizeof(uint32_t)*check.numOfNodes);
+    check.subtreeEnds = (int*) malloc(sizeof(int)*check.numOfNodes);
+    int failed = check.nodes == NULL || check.depths == NULL || check.subtreeEnds == NULL;
+    if (failed == 0) {
+        collectPreOrder(&check, root, 0, 0);
+    }
+    for (int pass = 0 ; pass < 2 && failed == 0 ; pass++) {
+        check.entered = check.left = 0;
+        check.stopAt = pass == 0 ? -1 : check.numOfNodes / 2;
+        check.failed = false;
+        status = VSSParseStream(fname, enterView, leaveView, &check);
+        int expectedEntered = pass == 0 ? check.numOfNodes : check.stopAt + 1;
+        failed = status != VSS_OK || check.failed == true || check.entered != expectedEntered || (pass == 0 && check.left != check.numOfNodes);
+        if (failed != 0) {
+            printf("Stream of %s %s: %s, %d nodes entered, %d left\n", fname, pass == 0 ? "differs from the loaded tree" : "did not stop",
+                   VSSGetStatusText(status), check.entered, check.left);
+        }
+    }
+    free(check.nodes);
+    free(check.depths);
+    free(check.subtreeEnds);
+    VSSFreeTree(root);
+    return failed;
+}
+
+typedef struct checkLoad_t {
+    char* label;
+    int formatVersion;
+    int loadFlags;
+} checkLoad_t;
+
+static checkLoad_t checkLoads[] = {
+    {"format 1", 1, VSS_LOAD_QUIET},
+    {"format 2", 2, VSS_LOAD_QUIET},
+    {"format 2 mmap", 2, VSS_LOAD_MMAP | VSS_LOAD_QUIET},
+    {"format 2 lazy", 2, VSS_LOAD_LAZY | VSS_LOAD_QUIET},
+};
+
+/**
+* Writes the check tree in both formats and checks each load mode of it, returns 0 if all checks pass.
+**/
+static int runFileChecks() {
+    char fnames[2][32];
+    int failed = 0;
+    for (int version = 1 ; version <= 2 ; version++) {
+        snprintf(fnames[version-1], sizeof(fnames[0]), "stresscheck_v%d.binary", version);
+        if (writeCheckTree(fnames[version-1], version) != 0) {
+            failed = 1;
+        }
+    }
+    for (int i = 0 ; i < (int)(sizeof(checkLoads)/sizeof(checkLoads[0])) && failed == 0 ; i++) {
+        int status;
+        long root = VSSLoadTree(fnames[checkLoads[i].formatVersion-1], checkLoads[i].loadFlags, &status);
+        if (root == 0) {
+            printf("%s: load failed with %s\n", checkLoads[i].label, VSSGetStatusText(status));
+            failed = 1;
+            break;
+        }
+        failed = checkRanges(checkLoads[i].label, root) || checkAllowed(checkLoads[i].label, root) || checkDescriptions(checkLoads[i].label, root) ||
+                 checkSearchCap(checkLoads[i].label, root) ||
+                 checkAttributeMask(checkLoads[i].label, fnames[checkLoads[i].formatVersion-1], checkLoads[i].loadFlags) ||
+                 checkStats(checkLoads[i].label, fnames[checkLoads[i].formatVersion-1], checkLoads[i].loadFlags);
+        VSSFreeTree(root);
+    }
+    if (failed == 0) {
+        failed = checkLazyLoad(fnames[1]);
+    }
+    if (failed == 0) {
+        failed = checkCorruptV1(fnames[0]) || checkVarints() || checkTruncatedVarint(fnames[1]) || checkLongAllowed();
+    }
+    for (int version = 1 ; version <= 2 && failed == 0 ; version++) {
+        failed = checkStream(fnames[version-1]);
+    }
+    remove(fnames[0]);
+    remove(fnames[1]);
+    return failed;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s <binary file> [max threads] [ms per thread count]\n", argv[0]);
+        return 1;
+    }
+    int maxThreads = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int runMs = argc > 3 ? atoi(argv[3]) : 1000;
+    if (runFileChecks() != 0 || checkStream(argv[1]) != 0) {
+        printf("File checks: FAILED\n");
+        return 1;
+    }
+    printf("File checks: OK\n");
+    int status;
+    rootNode = VSSLoadTree(argv[1], VSS_LOAD_MMAP | VSS_LOAD_COMPACT | VSS_LOAD_PATHINDEX, &status);
+    if (rootNode == 0) {
+        return 1;
+    }
+    nodeCount = countNodes(rootNode);
+    searchData_t* searchData = (searchData_t*) malloc(sizeof(searchData_t)*nodeCount);
+    if (searchData == NULL || createQueries(searchData) <= 0) {
+        return 1;
+    }
+    free(searchData);
+    printf("%d queries, %d online CPUs\n", numOfQueries, (int)sysconf(_SC_NPROCESSORS_ONLN));
+
+    double singleRate = 0;
+    for (int threads = 1 ; threads <= maxThreads ; threads = threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2) {
+        double rate = runThreads(threads, runMs, NULL);
+        if (rate < 0) {
+            printf("%d threads: FAILED\n", threads);
+            return 1;
+        }
+        if (threads == 1) {
+            singleRate = rate;
+        }
+        printf("%3d threads: %10.0f searches/s, scaling %5.2f\n", threads, rate, rate / singleRate);
+    }
+
+    managedTree = VSSOpenManagedTree(argv[1], VSS_LOAD_MMAP | VSS_LOAD_COMPACT | VSS_LOAD_PATHINDEX | VSS_LOAD_QUIET, VSS_ATTR_ALL, false, &status);
+    int reloads = 0;
+    double rate = managedTree != NULL ? runThreads(maxThreads, runMs, &reloads) : -1;
+    if (rate < 0) {
+        printf("%d threads on a reloaded tree: FAILED\n", maxThreads);
+        return 1;
+    }
+    printf("%3d threads: %10.0f searches/s, scaling %5.2f, during %d reloads\n", maxThreads, rate, rate / singleRate, reloads);
+    VSSCloseManagedTree(managedTree);
+    free(queries);
+    VSSFreeTree(rootNode);
+    return 0;
+}
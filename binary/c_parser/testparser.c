@@ -51,16 +51,41 @@ void showNodeData(long currentNode, int currentChild) {
         printf("#allowed=%d\n", VSSgetNumOfAllowedElements(currentNode));
         char* dtype = VSSgetDatatype(currentNode);
         if (dtype != NULL)
-            printf("Datatype = %s\n", dtype);
+            printf("Datatype = %s, code = %d%s\n", dtype, VSSgetDatatypeCode(currentNode), VSSgetDatatypeIsArray(currentNode) ? ", array" : "");
         char* tmp = VSSgetUnit(currentNode);
         if (tmp != NULL)
             printf("Unit = %s\n", tmp);
 }
 
+int showFoundNode(long nodeHandle, void* searchRoot) {
+        path_t path;
+        VSSGetPath(nodeHandle, *(long*)searchRoot, path, MAXCHARSPATH);
+        printf("Found node type=%s\n", getTypeName(VSSgetType(nodeHandle)));
+        printf("Found node datatype=%s\n", VSSgetDatatype(nodeHandle));
+        printf("Found path=%s\n", path);
+        return 0;
+}
+
+int showSubtreeNode(long nodeHandle, void* subtreeRoot) {
+        path_t path;
+        VSSGetPath(nodeHandle, *(long*)subtreeRoot, path, MAXCHARSPATH);
+        printf("Node type=%s\n", getTypeName(VSSgetType(nodeHandle)));
+        printf("Node path=%s\n", path);
+        printf("Node validation=%d\n", VSSgetValidation(nodeHandle));
+        return 0;
+}
+
 int main(int argc, char** argv) {
 
     vspecfile = argv[1];
-    rootNode = VSSReadTree(vspecfile);
+    int loadFlags = VSS_LOAD_DEFAULT;
+    if (argc > 2 && strcmp(argv[2], "mmap") == 0) {
+        loadFlags = VSS_LOAD_MMAP;
+    }
+    rootNode = VSSLoadTree(vspecfile, loadFlags, NULL);
+    if (rootNode == 0) {
+        return 1;
+    }
 
     char traverse[10];
     currentNode = rootNode;
@@ -102,14 +127,11 @@ int main(int argc, char** argv) {
                 char searchPath[MAXCHARSPATH];
                 printf("\nPath to resource(s): ");
                 scanf("%s", searchPath);
-                searchData_t searchData[MAXFOUNDNODES];
-                int foundResponses = VSSSearchNodes(searchPath, rootNode, MAXFOUNDNODES, searchData, true, true, 0, NULL, NULL);
-                printf("\nNumber of elements found=%d\n", foundResponses);
-                for (int i = 0 ; i < foundResponses ; i++) {
-                    printf("Found node type=%s\n", getTypeName(VSSgetType((long)(&(searchData[i]))->foundNodeHandles)));
-                    printf("Found node datatype=%s\n", VSSgetDatatype((long)(&(searchData[i]))->foundNodeHandles));
-                    printf("Found path=%s\n", (char*)(&(searchData[i]))->responsePaths);
-                }
+                vssPattern_t* pattern = VSSCompilePattern(searchPath);
+                printf("\n");
+                int foundResponses = VSSSearchStream(pattern, rootNode, true, true, 0, NULL, showFoundNode, &rootNode, NULL);
+                printf("Number of elements found=%d\n", foundResponses);
+                VSSFreePattern(pattern);
             }
             break;
             case 'n':  //create node list file "nodelist.txt"
@@ -132,21 +154,21 @@ int main(int argc, char** argv) {
                 int depth;
                 printf("\nSubtree depth: ");
                 scanf("%d", &depth);
-                searchData_t searchData[MAXFOUNDNODES];
-                int foundResponses = VSSSearchNodes(subTreePath, rootNode, MAXFOUNDNODES, searchData, false, false, 0, NULL, NULL);
-                long subtreeNode = (long)(&(searchData[foundResponses-1]))->foundNodeHandles;
+                long subtreeNode = VSSLookupPath(rootNode, subTreePath, false);
+                if (subtreeNode == 0) {
+                    printf("\nNo node with path %s\n", subTreePath);
+                    break;
+                }
                 char subTreeRootName[MAXCHARSPATH];
-                strcpy(subTreeRootName, VSSgetName((long)(&(searchData[foundResponses-1]))->foundNodeHandles));
-                for (int i = 1 ; i < depth ; i++) {
+                strcpy(subTreeRootName, VSSgetName(subtreeNode));
+                for (int i = 1 ; i < depth && strlen(subTreeRootName) + 2 < MAXCHARSPATH ; i++) {
                     strcat(subTreeRootName, ".*");
                 }
-                foundResponses = VSSSearchNodes(subTreeRootName, subtreeNode, MAXFOUNDNODES, searchData, false, false, 0, NULL, NULL);
-                printf("\nNumber of elements found=%d\n", foundResponses);
-                for (int i = 0 ; i < foundResponses ; i++) {
-                    printf("Node type=%s\n", getTypeName(VSSgetType((long)(&(searchData[i]))->foundNodeHandles)));
-                    printf("Node path=%s\n", (char*)(&(searchData[i]))->responsePaths);
-                    printf("Node validation=%d\n", VSSgetValidation((long)(&(searchData[i]))->foundNodeHandles));
-                }
+                vssPattern_t* pattern = VSSCompilePattern(subTreeRootName);
+                printf("\n");
+                int foundResponses = VSSSearchStream(pattern, subtreeNode, false, false, 0, NULL, showSubtreeNode, &subtreeNode, NULL);
+                printf("Number of elements found=%d\n", foundResponses);
+                VSSFreePattern(pattern);
             }
             break;
             case 'h':  //help
@@ -156,6 +178,7 @@ int main(int argc, char** argv) {
                 VSSWriteTree(vspecfile, rootNode);
             break;
             default:
+                VSSFreeTree(rootNode);
                 return 0;
         }  //switch
     } //while
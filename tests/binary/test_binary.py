@@ -17,9 +17,9 @@ def change_test_dir(request, monkeypatch):
     monkeypatch.chdir(request.fspath.dirname)
 
 
-def check_expected_for_tool(signal_name: str, grep_str: str, tool_path: str):
+def check_expected_for_tool(signal_name: str, grep_str: str, tool_path: str, binary_file: str = "test.binary"):
 
-    test_str = "printf '%s\n' 'm' " + signal_name + "  '1' 'q' | " + tool_path + " test.binary > out.txt"
+    test_str = "printf '%s\n' 'm' " + signal_name + "  '1' 'q' | " + tool_path + " " + binary_file + " > out.txt"
     result = os.system(test_str)
     assert os.WIFEXITED(result)
     assert os.WEXITSTATUS(result) == 0
@@ -49,7 +49,7 @@ def test_binary(change_test_dir):
     assert os.WIFEXITED(result)
     assert os.WEXITSTATUS(result) == 0
 
-    test_str = "cc ../../binary/c_parser/testparser.c ../../binary/c_parser/cparserlib.c -o ctestparser"
+    test_str = "cc -pthread ../../binary/c_parser/testparser.c ../../binary/c_parser/cparserlib.c -o ctestparser"
     result = os.system(test_str)
     assert os.WIFEXITED(result)
     assert os.WEXITSTATUS(result) == 0
@@ -63,5 +63,98 @@ def test_binary(change_test_dir):
     check_expected('A.String', 'Node type=SENSOR')
     check_expected('A.Int', 'Node type=ACTUATOR')
 
-    os.system("rm -f test.binary ctestparser out.txt")
+    # Format version 2 is only supported by the C parser
+    test_str = "../../vspec2binary.py --binary-format-version 2 -u ../vspec/test_units.yaml test.vspec test_v2.binary"
+    result = os.system(test_str)
+    assert os.WIFEXITED(result)
+    assert os.WEXITSTATUS(result) == 0
+
+    check_expected_for_tool('A.String', 'Node type=SENSOR', "./ctestparser", "test_v2.binary")
+    check_expected_for_tool('A.Int', 'Node type=ACTUATOR', "./ctestparser", "test_v2.binary")
+    check_expected_for_tool('A.String', 'Node type=SENSOR', "./ctestparser", "test_v2.binary mmap")
+
+    # Concurrent searches on one shared tree must give the same results as single threaded searches
+    test_str = "cc -pthread ../../binary/c_parser/stressparser.c ../../binary/c_parser/cparserlib.c " \
+               "../../binary/binarytool.c -o cstressparser"
+    result = os.system(test_str)
+    assert os.WIFEXITED(result)
+    assert os.WEXITSTATUS(result) == 0
+
+    for binary_file in ["test.binary", "test_v2.binary"]:
+        result = os.system("./cstressparser " + binary_file + " 4 200 > out.txt")
+        assert os.WIFEXITED(result)
+        assert os.WEXITSTATUS(result) == 0
+
+    os.system("rm -f test.binary test_v2.binary ctestparser cstressparser out.txt")
     os.system("rm -f ../../binary/go_parser/gotestparser  ../../binary/go_parser/out.txt")
+
+
+def test_binary_long_allowed(change_test_dir):
+    """
+    Format version 2 has no limit on the length of an allowed value, while format version 1 must refuse a value
+    longer than its 255 byte hex length instead of writing a malformed file.
+    """
+    test_str = "gcc -shared -o ../../binary/binarytool.so -fPIC ../../binary/binarytool.c"
+    result = os.system(test_str)
+    assert os.WIFEXITED(result)
+    assert os.WEXITSTATUS(result) == 0
+
+    test_str = "cc -pthread ../../binary/c_parser/testparser.c ../../binary/c_parser/cparserlib.c -o ctestparser"
+    result = os.system(test_str)
+    assert os.WIFEXITED(result)
+    assert os.WEXITSTATUS(result) == 0
+
+    with open("long_allowed.vspec", "w") as vspec_file:
+        vspec_file.write("A:\n  type: branch\n  description: Branch A.\n\n"
+                         "A.Enum:\n  datatype: string\n  type: sensor\n  description: An enum\n"
+                         "  allowed: ['" + "X" * 300 + "', 'Short']\n")
+
+    test_str = "../../vspec2binary.py --binary-format-version 2 -u ../vspec/test_units.yaml long_allowed.vspec " \
+               "long_allowed.binary"
+    result = os.system(test_str)
+    assert os.WIFEXITED(result)
+    assert os.WEXITSTATUS(result) == 0
+
+    # down to A.Enum, which prints its number of allowed values
+    result = os.system("printf '%s\\n' 'd' 'q' | ./ctestparser long_allowed.binary | grep '#allowed=2' > /dev/null")
+    assert os.WIFEXITED(result)
+    assert os.WEXITSTATUS(result) == 0
+
+    test_str = "../../vspec2binary.py -u ../vspec/test_units.yaml long_allowed.vspec long_allowed.binary > out.txt 2>&1"
+    result = os.system(test_str)
+    assert os.WIFEXITED(result)
+    assert os.WEXITSTATUS(result) != 0
+
+    os.system("rm -f long_allowed.vspec long_allowed.binary ctestparser out.txt")
+
+
+def test_binary_write_fails(change_test_dir):
+    """
+    A tree that format version 1 cannot hold must fail the command, and leave an existing output file unchanged.
+    """
+    test_str = "gcc -shared -o ../../binary/binarytool.so -fPIC ../../binary/binarytool.c"
+    result = os.system(test_str)
+    assert os.WIFEXITED(result)
+    assert os.WEXITSTATUS(result) == 0
+
+    with open("wide.vspec", "w") as vspec_file:
+        vspec_file.write("A:\n  type: branch\n  description: Branch A.\n")
+        for i in range(256):
+            vspec_file.write("\nA.S" + str(i) + ":\n  datatype: uint8\n  type: sensor\n  description: A sensor\n")
+    with open("wide.binary", "w") as binary_file:
+        binary_file.write("previous")
+
+    test_str = "../../vspec2binary.py -u ../vspec/test_units.yaml wide.vspec wide.binary > out.txt 2>&1"
+    result = os.system(test_str)
+    assert os.WIFEXITED(result)
+    assert os.WEXITSTATUS(result) != 0
+    with open("wide.binary") as binary_file:
+        assert binary_file.read() == "previous"
+    assert not os.path.exists("wide.binary.tmp")
+
+    test_str = "../../vspec2binary.py --binary-format-version 2 -u ../vspec/test_units.yaml wide.vspec wide.binary"
+    result = os.system(test_str)
+    assert os.WIFEXITED(result)
+    assert os.WEXITSTATUS(result) == 0
+
+    os.system("rm -f wide.vspec wide.binary out.txt")
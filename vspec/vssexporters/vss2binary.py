@@ -14,7 +14,9 @@ import argparse
 import logging
 import ctypes
 import os.path
-from typing import Optional
+import struct
+import vspec
+from typing import List, Optional
 from vspec.model.vsstree import VSSNode, VSSType
 from vspec.vss2x import Vss2X
 from vspec.vspec2vss_config import Vspec2VssConfig
@@ -23,11 +25,15 @@ out_file = ""
 _cbinary = None
 
 
-def createBinaryCnode(fname, nodename, nodetype, uuid, description, nodedatatype, nodemin, nodemax, unit, allowed,
-                      defaultAllowed, validate, children):
-    global _cbinary
-    _cbinary.createBinaryCnode(fname, nodename, nodetype, uuid, description, nodedatatype, nodemin, nodemax, unit,
-                               allowed, defaultAllowed, validate, children)
+def packNode(packed, nodename, nodetype, uuid, description, nodedatatype, nodemin, nodemax, unit, allowed,
+             defaultAllowed, validate, children):
+    # Record layout expected by createBinaryCtree() in binarytool.c:
+    # uint32 little endian length + bytes for each field, followed by the number of children as uint32
+    for field in (nodename, nodetype, uuid, description, nodedatatype, nodemin, nodemax, unit, allowed,
+                  defaultAllowed, validate):
+        packed.append(struct.pack('<I', len(field)))
+        packed.append(field)
+    packed.append(struct.pack('<I', children))
 
 
 def allowedString(allowedList):
@@ -38,6 +44,17 @@ def allowedString(allowedList):
     return allowedStr
 
 
+def packAllowed(allowedList):
+    # Format version 2 allowed field expected by createBinaryCtree(), which is not limited to 255 bytes per element:
+    # uint32 little endian count, followed by uint32 little endian length + bytes for each element
+    packed = [struct.pack('<I', len(allowedList))]
+    for elem in allowedList:
+        b_elem = str(elem).encode('utf-8')
+        packed.append(struct.pack('<I', len(b_elem)))
+        packed.append(b_elem)
+    return b"".join(packed)
+
+
 def hexAllowedLen(allowed):
     hexDigit1 = len(allowed) // 16
     hexDigit2 = len(allowed) - hexDigit1*16
@@ -52,7 +69,7 @@ def intToHexChar(hexInt):
         return chr(hexInt - 10 + ord('A'))
 
 
-def export_node(node, generate_uuid, out_file):
+def export_node(node, generate_uuid, format_version, packed):
     nodename = str(node.name)
     b_nodename = nodename.encode('utf-8')
 
@@ -86,9 +103,15 @@ def export_node(node, generate_uuid, out_file):
         nodemax = str(node.max)
     b_nodemax = nodemax.encode('utf-8')
 
-    if node.allowed != "":
-        nodeallowed = allowedString(node.allowed)
-    b_nodeallowed = nodeallowed.encode('utf-8')
+    if node.allowed != "" and format_version == 2:
+        b_nodeallowed = packAllowed(node.allowed)
+    else:
+        if node.allowed != "":
+            if any(len(elem) > 255 for elem in node.allowed):
+                raise vspec.VSpecError(node.qualified_name(), 0, "An allowed value is longer than binary format "
+                                       "version 1 allows, use --binary-format-version 2")
+            nodeallowed = allowedString(node.allowed)
+        b_nodeallowed = nodeallowed.encode('utf-8')
 
     if node.default != "":
         nodedefault = str(node.default)
@@ -109,13 +132,13 @@ def export_node(node, generate_uuid, out_file):
         nodevalidate = node.extended_attributes["validate"]
     b_nodevalidate = nodevalidate.encode('utf-8')
 
-    b_fname = out_file.encode('utf-8')
-
-    createBinaryCnode(b_fname, b_nodename, b_nodetype, b_nodeuuid, b_nodedescription, b_nodedatatype, b_nodemin,
-                      b_nodemax, b_nodeunit, b_nodeallowed, b_nodedefault, b_nodevalidate, children)
+    packNode(packed, b_nodename, b_nodetype, b_nodeuuid, b_nodedescription, b_nodedatatype, b_nodemin,
+             b_nodemax, b_nodeunit, b_nodeallowed, b_nodedefault, b_nodevalidate, children)
+    nodeCount = 1
 
     for child in node.children:
-        export_node(child, generate_uuid, out_file)
+        nodeCount += export_node(child, generate_uuid, format_version, packed)
+    return nodeCount
 
 
 class Vss2Binary(Vss2X):
@@ -124,6 +147,11 @@ class Vss2Binary(Vss2X):
         vspec2vss_config.type_tree_supported = False
         vspec2vss_config.no_expand_option_supported = False
 
+    def add_arguments(self, parser: argparse.ArgumentParser) -> None:
+        parser.add_argument('--binary-format-version', type=int, choices=[1, 2], default=1,
+                            help="Binary format version, 1 (default) is the original format, "
+                                 "2 adds a header, a node offset table and a string pool.")
+
     def generate(self, config: argparse.Namespace, root: VSSNode, vspec2vss_config: Vspec2VssConfig,
                  data_type_root: Optional[VSSNode] = None) -> None:
         global _cbinary
@@ -136,12 +164,16 @@ class Vss2Binary(Vss2X):
             return
         _cbinary = ctypes.CDLL(dllAbsPath)
 
-        _cbinary.createBinaryCnode.argtypes = (ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p,
-                                               ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p,
-                                               ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p,
+        _cbinary.createBinaryCtree.argtypes = (ctypes.c_char_p, ctypes.c_char_p, ctypes.c_size_t, ctypes.c_int,
                                                ctypes.c_int)
+        _cbinary.createBinaryCtree.restype = ctypes.c_int
 
         logging.info("Generating binary output...")
         out_file = config.output_file
-        export_node(root, vspec2vss_config.generate_uuid, out_file)
+        packed: List[bytes] = []
+        nodeCount = export_node(root, vspec2vss_config.generate_uuid, config.binary_format_version, packed)
+        packedNodes = b"".join(packed)
+        if _cbinary.createBinaryCtree(out_file.encode('utf-8'), packedNodes, len(packedNodes), nodeCount,
+                                      config.binary_format_version) != 0:
+            raise vspec.VSpecError(out_file, 0, "Could not write binary output")
         logging.info("Binary output generated in " + out_file)